@@ -98,7 +98,7 @@ int main(int argc, char *argv[])
         // Get the next available frame.
         // the Frame struct is simply a POD containing
         // all the information that you need to record a command buffer
-        auto frame = window->acquireNextFrame();
+        auto & frame = window->acquireNextFrame();
 
 
         frame.beginCommandBuffer();
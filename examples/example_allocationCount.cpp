@@ -0,0 +1,174 @@
+#include <iostream>
+#include <atomic>
+#include <algorithm>
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+
+#include <vkw/VKWVulkanWindow.h>
+#include <vkw/Adapters/SDLVulkanWindowAdapter.h>
+
+// This test checks that the acquireNextFrame() -> record ->
+// submitFrame() -> presentFrame() path does not allocate any
+// memory once it has reached a steady state.
+//
+// Every global operator new is replaced with one that counts the
+// number of allocations. After a number of warm up frames, the
+// allocations made between acquiring and presenting each frame
+// are counted. The program exits with a non-zero value if any
+// frame allocated memory, so it can be run with ctest.
+//
+// A window and a Vulkan device are required. Do not resize the
+// window while this is running, rebuilding the swapchain is
+// allowed to allocate.
+
+static std::atomic<uint64_t> g_allocationCount(0);
+
+static void* countedAlloc(std::size_t size, std::size_t alignment) noexcept
+{
+    ++g_allocationCount;
+    if( size == 0 )
+        size = 1;
+#if defined(_MSC_VER)
+    if( alignment > alignof(std::max_align_t) )
+        return _aligned_malloc(size, alignment);
+    return std::malloc(size);
+#else
+    if( alignment > alignof(std::max_align_t) )
+        return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    return std::malloc(size);
+#endif
+}
+
+static void countedFree(void * p, std::size_t alignment) noexcept
+{
+#if defined(_MSC_VER)
+    if( alignment > alignof(std::max_align_t) )
+    {
+        _aligned_free(p);
+        return;
+    }
+#else
+    (void)alignment;
+#endif
+    std::free(p);
+}
+
+static void* countedAllocOrThrow(std::size_t size, std::size_t alignment)
+{
+    if( void * p = countedAlloc(size, alignment) )
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new  (std::size_t size)                                               { return countedAllocOrThrow(size, alignof(std::max_align_t)); }
+void* operator new[](std::size_t size)                                               { return countedAllocOrThrow(size, alignof(std::max_align_t)); }
+void* operator new  (std::size_t size, std::nothrow_t const &) noexcept              { return countedAlloc(size, alignof(std::max_align_t)); }
+void* operator new[](std::size_t size, std::nothrow_t const &) noexcept              { return countedAlloc(size, alignof(std::max_align_t)); }
+void* operator new  (std::size_t size, std::align_val_t a)                           { return countedAllocOrThrow(size, static_cast<std::size_t>(a)); }
+void* operator new[](std::size_t size, std::align_val_t a)                           { return countedAllocOrThrow(size, static_cast<std::size_t>(a)); }
+void* operator new  (std::size_t size, std::align_val_t a, std::nothrow_t const &) noexcept { return countedAlloc(size, static_cast<std::size_t>(a)); }
+void* operator new[](std::size_t size, std::align_val_t a, std::nothrow_t const &) noexcept { return countedAlloc(size, static_cast<std::size_t>(a)); }
+
+void operator delete  (void * p) noexcept                                            { countedFree(p, alignof(std::max_align_t)); }
+void operator delete[](void * p) noexcept                                            { countedFree(p, alignof(std::max_align_t)); }
+void operator delete  (void * p, std::size_t) noexcept                               { countedFree(p, alignof(std::max_align_t)); }
+void operator delete[](void * p, std::size_t) noexcept                               { countedFree(p, alignof(std::max_align_t)); }
+void operator delete  (void * p, std::nothrow_t const &) noexcept                    { countedFree(p, alignof(std::max_align_t)); }
+void operator delete[](void * p, std::nothrow_t const &) noexcept                    { countedFree(p, alignof(std::max_align_t)); }
+void operator delete  (void * p, std::align_val_t a) noexcept                        { countedFree(p, static_cast<std::size_t>(a)); }
+void operator delete[](void * p, std::align_val_t a) noexcept                        { countedFree(p, static_cast<std::size_t>(a)); }
+void operator delete  (void * p, std::size_t, std::align_val_t a) noexcept           { countedFree(p, static_cast<std::size_t>(a)); }
+void operator delete[](void * p, std::size_t, std::align_val_t a) noexcept           { countedFree(p, static_cast<std::size_t>(a)); }
+void operator delete  (void * p, std::align_val_t a, std::nothrow_t const &) noexcept { countedFree(p, static_cast<std::size_t>(a)); }
+void operator delete[](void * p, std::align_val_t a, std::nothrow_t const &) noexcept { countedFree(p, static_cast<std::size_t>(a)); }
+
+
+#if defined(__WIN32__)
+int SDL_main(int argc, char *argv[])
+#else
+int main(int argc, char *argv[])
+#endif
+{
+    (void)argc;
+    (void)argv;
+
+    SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS);
+
+    auto window     = new vkw::VKWVulkanWindow();
+    auto sdl_window = new vkw::SDLVulkanWindowAdapter();
+
+    sdl_window->createWindow("Allocation Count", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 1024, 768);
+    window->setWindowAdapater(sdl_window);
+
+    vkw::VKWVulkanWindow::InstanceInitilizationInfo2 instanceInfo;
+    instanceInfo.vulkanVersion = VK_MAKE_VERSION(1, 2, 0);
+    window->createVulkanInstance(instanceInfo);
+
+    // do not wait for vsync, FIFO is used if immediate
+    // presentation is not supported
+    vkw::VKWVulkanWindow::SurfaceInitilizationInfo2 surfaceInfo;
+    surfaceInfo.depthFormat = VK_FORMAT_D32_SFLOAT_S8_UINT;
+    surfaceInfo.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    window->createVulkanSurface(surfaceInfo);
+
+    vkw::VKWVulkanWindow::DeviceInitilizationInfo2 deviceInfo;
+    window->createVulkanDevice(deviceInfo);
+
+    const uint32_t warmUpFrames  = 120;
+    const uint32_t measureFrames = 600;
+    uint64_t       maxPerFrame   = 0;
+    uint64_t       total         = 0;
+
+    for(uint32_t i = 0; i < warmUpFrames + measureFrames; i++)
+    {
+        SDL_Event event;
+        bool resize = false;
+        bool quit   = false;
+        while( SDL_PollEvent(&event) )
+        {
+            if( event.type == SDL_QUIT )
+                quit = true;
+            else if( event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED )
+                resize = true;
+        }
+        if( quit )
+            break;
+        if( resize )
+            window->rebuildSwapchain();
+
+        uint64_t before = g_allocationCount.load();
+
+        auto & frame = window->acquireNextFrame();
+
+        frame.beginCommandBuffer();
+            frame.clearColor = {{0.f, 0.f, 1.f, 1.f}};
+            frame.beginRenderPass(frame.commandBuffer);
+            frame.endRenderPass(frame.commandBuffer);
+        frame.endCommandBuffer();
+
+        window->submitFrame(frame);
+        window->presentFrame(frame);
+
+        uint64_t perFrame = g_allocationCount.load() - before;
+
+        // rebuilding the swapchain is allowed to allocate
+        if( i >= warmUpFrames && !resize )
+        {
+            maxPerFrame = std::max(maxPerFrame, perFrame);
+            total      += perFrame;
+        }
+    }
+
+    window->destroy();
+    delete window;
+
+    SDL_Quit();
+
+    std::cout << "Allocations in " << measureFrames << " steady state frames: " << total
+              << " (max " << maxPerFrame << " per frame)" << std::endl;
+
+    return total == 0 ? 0 : 1;
+}
+
+#include <vkw/VKWVulkanWindow.inl>
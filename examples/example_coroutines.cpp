@@ -0,0 +1,151 @@
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+//#define VKW_WINDOW_LIB 1
+
+#if VKW_WINDOW_LIB == 1
+#include <vkw/SDLWidget.h>
+#elif VKW_WINDOW_LIB == 2
+#include <vkw/GLFWWidget.h>
+#endif
+
+#include "example_myApplication.h"
+
+#if !defined(VKW_HAS_COROUTINES)
+#error "This example must be compiled as C++20"
+#endif
+
+// This example shows how frame logic can co_await GPU work
+// instead of polling. One coroutine waits for frames to
+// complete on the GPU, the other throws an exception, which
+// is rethrown out of the widget's exec() loop.
+
+class CoroutineApplication : public MyApplication
+{
+public:
+    void initResources() override
+    {
+        MyApplication::initResources();
+        countFrames();
+    }
+
+    void render( vkw::Frame &frame) override
+    {
+        if( frame.frameNumber == 300 )
+        {
+            failLater(frame.frameNumber);
+        }
+        MyApplication::render(frame);
+    }
+
+    vkw::FrameTask countFrames()
+    {
+        for(uint32_t i=0; i < 5; i++)
+        {
+            co_await coroutines().nextFrame();
+            auto n = completedFrameNumber();
+
+            co_await coroutines().frameCompleted(n + 60);
+            std::cout << "frame " << n + 60 << " has completed on the GPU" << std::endl;
+        }
+    }
+
+    vkw::FrameTask failLater(uint64_t frameNumber)
+    {
+        co_await coroutines().frameCompleted(frameNumber);
+        throw std::runtime_error("frame " + std::to_string(frameNumber) + " has completed, stopping");
+    }
+};
+
+int MAIN(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+#if VKW_WINDOW_LIB == 1
+    using WidgetType = vkw::SDLVulkanWidget;
+#elif VKW_WINDOW_LIB == 2
+    using WidgetType = vkw::GLFWVulkanWidget;
+#endif
+
+    WidgetType vulkanWindow;
+
+    WidgetType::CreateInfo c;
+    c.width       = 1024;
+    c.height      = 768;
+    c.windowTitle = "Coroutines";
+
+    c.instanceInfo.vulkanVersion = VK_MAKE_VERSION(1,2,0);
+
+    c.surfaceInfo.presentMode    = VK_PRESENT_MODE_FIFO_KHR;
+    c.surfaceInfo.depthFormat    = VK_FORMAT_D32_SFLOAT_S8_UINT;
+
+    CoroutineApplication app;
+
+    #if VKW_WINDOW_LIB == 1
+        SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS);
+
+        vulkanWindow.create(c);
+
+        try
+        {
+            vulkanWindow.exec(&app,
+                              [&app](SDL_Event const & evt)
+            {
+                if( evt.type == SDL_QUIT)
+                    app.quit();
+            });
+        }
+        catch(std::exception & e)
+        {
+            std::cout << "exec() threw: " << e.what() << std::endl;
+        }
+
+        vulkanWindow.destroy();
+
+        SDL_Quit();
+
+    #elif VKW_WINDOW_LIB == 2
+
+        glfwInit();
+
+        vulkanWindow.create(c);
+
+        try
+        {
+            vulkanWindow.exec(&app);
+        }
+        catch(std::exception & e)
+        {
+            std::cout << "exec() threw: " << e.what() << std::endl;
+        }
+
+        vulkanWindow.destroy();
+
+        glfwTerminate();
+    #endif
+
+    return 0;
+}
+
+
+#if VKW_WINDOW_LIB == 1
+
+    #if defined(__WIN32__)
+    int SDL_main(int argc, char *argv[])
+    #else
+    int main(int argc, char *argv[])
+    #endif
+    {
+        return MAIN(argc, argv);
+    }
+#elif VKW_WINDOW_LIB == 2
+    int main(int argc, char *argv[])
+    {
+        return MAIN(argc, argv);
+    }
+#endif
+
+
+#include <vkw/VKWVulkanWindow.inl>
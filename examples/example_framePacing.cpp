@@ -0,0 +1,142 @@
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+
+//#define VKW_WINDOW_LIB 1
+
+#if VKW_WINDOW_LIB == 1
+#include <vkw/SDLWidget.h>
+#elif VKW_WINDOW_LIB == 2
+#include <vkw/GLFWWidget.h>
+#endif
+
+// This example measures the average frame time using the two
+// frame pacing modes. The application alternates between
+// FramePacing::QueueWaitIdle and FramePacing::FrameFence every
+// few hundred frames and prints the results.
+//
+// Pass the number of milliseconds of simulated CPU work per frame
+// as the first argument. eg:
+//
+//     ./example_framePacing_sdl 8
+//
+// With QueueWaitIdle the frame time will be roughly cpu+gpu time,
+// with FrameFence it will be roughly max(cpu, gpu) time.
+
+#include "example_myApplication.h"
+
+int MAIN(int argc, char *argv[])
+{
+    double cpuWorkMs = argc > 1 ? std::atof(argv[1]) : 8.0;
+
+#if VKW_WINDOW_LIB == 1
+    using WidgetType = vkw::SDLVulkanWidget;
+#elif VKW_WINDOW_LIB == 2
+    using WidgetType = vkw::GLFWVulkanWidget;
+#endif
+
+    WidgetType vulkanWindow;
+
+    WidgetType::CreateInfo c;
+    c.width       = 1024;
+    c.height      = 768;
+    c.windowTitle = "Frame Pacing";
+
+    c.instanceInfo.vulkanVersion = VK_MAKE_VERSION(1,2,0);
+
+    c.surfaceInfo.presentMode    = VK_PRESENT_MODE_FIFO_KHR;
+    c.surfaceInfo.depthFormat    = VK_FORMAT_D32_SFLOAT_S8_UINT;
+    c.surfaceInfo.framesInFlight = 2;
+
+    MyApplication app;
+
+    using clock_type = std::chrono::steady_clock;
+
+    const uint32_t framesPerMeasurement = 300;
+    uint32_t       frameCount = 0;
+    auto           startTime  = clock_type::now();
+    vkw::VKWVulkanWindow::FramePacing pacing = vkw::VKWVulkanWindow::FramePacing::QueueWaitIdle;
+
+    // called once per frame. Simulates some CPU work and
+    // switches the pacing mode after every measurement
+    auto mainLoop = [&]()
+    {
+        auto workEnd = clock_type::now() + std::chrono::duration<double, std::milli>(cpuWorkMs);
+        while( clock_type::now() < workEnd )
+        {
+        }
+
+        if( ++frameCount == framesPerMeasurement )
+        {
+            auto now = clock_type::now();
+            double avgMs = std::chrono::duration<double, std::milli>(now - startTime).count() / framesPerMeasurement;
+
+            std::cout << (pacing == vkw::VKWVulkanWindow::FramePacing::QueueWaitIdle ? "QueueWaitIdle" : "FrameFence   ")
+                      << " : cpu work " << cpuWorkMs << " ms"
+                      << " : avg frame time " << avgMs << " ms"
+                      << " (" << 1000.0 / avgMs << " fps)" << std::endl;
+
+            pacing = pacing == vkw::VKWVulkanWindow::FramePacing::QueueWaitIdle ?
+                                    vkw::VKWVulkanWindow::FramePacing::FrameFence :
+                                    vkw::VKWVulkanWindow::FramePacing::QueueWaitIdle;
+            vulkanWindow.setFramePacing(pacing);
+
+            frameCount = 0;
+            startTime  = clock_type::now();
+        }
+    };
+
+    #if VKW_WINDOW_LIB == 1
+        SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS);
+
+        vulkanWindow.create(c);
+        vulkanWindow.setFramePacing(pacing);
+
+        vulkanWindow.exec(&app,
+                          [&app](SDL_Event const & evt)
+        {
+            if( evt.type == SDL_QUIT)
+                app.quit();
+        }, mainLoop);
+
+        vulkanWindow.destroy();
+
+        SDL_Quit();
+
+    #elif VKW_WINDOW_LIB == 2
+
+        glfwInit();
+
+        vulkanWindow.create(c);
+        vulkanWindow.setFramePacing(pacing);
+
+        vulkanWindow.exec(&app, mainLoop);
+
+        vulkanWindow.destroy();
+
+        glfwTerminate();
+    #endif
+
+    return 0;
+}
+
+
+#if VKW_WINDOW_LIB == 1
+
+    #if defined(__WIN32__)
+    int SDL_main(int argc, char *argv[])
+    #else
+    int main(int argc, char *argv[])
+    #endif
+    {
+        return MAIN(argc, argv);
+    }
+#elif VKW_WINDOW_LIB == 2
+    int main(int argc, char *argv[])
+    {
+        return MAIN(argc, argv);
+    }
+#endif
+
+
+#include <vkw/VKWVulkanWindow.inl>
@@ -7,6 +7,7 @@
 #include "VulkanWindowAdapter.h"
 #include <vector>
 #include <string>
+#include <atomic>
 
 namespace vkw
 {
@@ -19,6 +20,11 @@ struct GLFWVulkanWindowAdapter : public VulkanWindowAdapater
     {
         bool requiresResize = false;
         VkExtent2D windowExtent;
+
+        // written by the callbacks on the main thread, but may be
+        // read by the render thread
+        std::atomic<bool> iconified{false};
+        std::atomic<bool> focused{true};
     };
     GLFWUserPointer    * m_userPtr = nullptr;
 
@@ -32,6 +38,8 @@ struct GLFWVulkanWindowAdapter : public VulkanWindowAdapater
         m_userPtr->requiresResize = false;
         m_userPtr->windowExtent   = { static_cast<uint32_t>(w), static_cast<uint32_t>(h)};
         glfwSetFramebufferSizeCallback(m_window, GLFWVulkanWindowAdapter::framebufferResizeCallback);
+        glfwSetWindowIconifyCallback(m_window, GLFWVulkanWindowAdapter::iconifyCallback);
+        glfwSetWindowFocusCallback(m_window, GLFWVulkanWindowAdapter::focusCallback);
         glfwSetWindowUserPointer(m_window, m_userPtr);
     }
 
@@ -41,6 +49,24 @@ struct GLFWVulkanWindowAdapter : public VulkanWindowAdapater
         usrPtr->requiresResize = true;
         usrPtr->windowExtent   = { static_cast<uint32_t>(w), static_cast<uint32_t>(h)};
     }
+    static void iconifyCallback(GLFWwindow* window, int iconified)
+    {
+        auto usrPtr = static_cast<GLFWUserPointer*>(glfwGetWindowUserPointer(window));
+        usrPtr->iconified = iconified == GLFW_TRUE;
+    }
+    static void focusCallback(GLFWwindow* window, int focused)
+    {
+        auto usrPtr = static_cast<GLFWUserPointer*>(glfwGetWindowUserPointer(window));
+        usrPtr->focused = focused == GLFW_TRUE;
+    }
+    bool isIconified() const
+    {
+        return m_userPtr->iconified;
+    }
+    bool isFocused() const
+    {
+        return m_userPtr->focused;
+    }
     bool requiresResize() const
     {
         return m_userPtr->requiresResize;
@@ -0,0 +1,60 @@
+#ifndef VKW_DOUBLE_BUFFER_H
+#define VKW_DOUBLE_BUFFER_H
+
+#include <utility>
+
+namespace vkw
+{
+
+/**
+ * @brief The DoubleBuffer class
+ *
+ * Two copies of T: the front copy is read by the render thread
+ * while the back copy is written by the update. Call swap() when
+ * neither of them is being accessed, eg: from Application::publishUpdate().
+ *
+ * @code
+ * struct Snapshot { std::vector<glm::mat4> transforms; };
+ * vkw::DoubleBuffer<Snapshot> m_snapshot;
+ *
+ * void update(double dt) override { ...; m_snapshot.back() = ...; }
+ * void publishUpdate() override   { m_snapshot.swap(); }
+ * void render(vkw::Frame & f) override { auto & s = m_snapshot.front(); ... }
+ * @endcode
+ */
+template<typename T>
+class DoubleBuffer
+{
+public:
+    T & back()
+    {
+        return m_buffers[1-m_front];
+    }
+    T const & front() const
+    {
+        return m_buffers[m_front];
+    }
+    T & front()
+    {
+        return m_buffers[m_front];
+    }
+
+    /**
+     * @brief swap
+     *
+     * The back buffer becomes the front buffer. The new back
+     * buffer holds the state from two updates ago.
+     */
+    void swap()
+    {
+        m_front = 1-m_front;
+    }
+
+protected:
+    T   m_buffers[2];
+    int m_front = 0;
+};
+
+}
+
+#endif
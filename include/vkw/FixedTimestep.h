@@ -0,0 +1,122 @@
+#ifndef VKW_FIXED_TIMESTEP_H
+#define VKW_FIXED_TIMESTEP_H
+
+#include <chrono>
+#include <cstdint>
+
+namespace vkw
+{
+
+/**
+ * @brief The FixedTimestep class
+ *
+ * Converts the variable time between frames into a whole number
+ * of fixed size simulation steps. The time which is left over is
+ * carried to the next frame and is reported as the interpolation
+ * alpha, in the range [0,1), which the renderer can use to blend
+ * between the last two simulated states.
+ *
+ * If the simulation falls too far behind (eg: the window was
+ * being dragged), at most maxSteps are taken and the rest of
+ * the time is dropped.
+ */
+class FixedTimestep
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+    using duration   = std::chrono::duration<double>;
+
+    /**
+     * @brief setTimestep
+     *
+     * Sets the length of a single simulation step.
+     * A value of zero disables the fixed timestep update.
+     */
+    void setTimestep(duration dt)
+    {
+        m_timestep = dt;
+    }
+    duration getTimestep() const
+    {
+        return m_timestep;
+    }
+    bool isEnabled() const
+    {
+        return m_timestep.count() > 0.0;
+    }
+
+    void setMaxSteps(uint32_t n)
+    {
+        m_maxSteps = n == 0 ? 1 : n;
+    }
+    uint32_t getMaxSteps() const
+    {
+        return m_maxSteps;
+    }
+
+    /**
+     * @brief advance
+     * @param now
+     * @return
+     *
+     * Returns the number of steps which should be simulated
+     * to catch up to now.
+     */
+    uint32_t advance(clock_type::time_point now = clock_type::now())
+    {
+        if( !m_started )
+        {
+            m_started = true;
+            m_last    = now;
+        }
+        m_accumulator += std::chrono::duration_cast<duration>(now - m_last);
+        m_last         = now;
+
+        uint32_t steps = 0;
+        while( m_accumulator >= m_timestep && steps < m_maxSteps )
+        {
+            m_accumulator -= m_timestep;
+            ++steps;
+        }
+        if( m_accumulator >= m_timestep )
+        {
+            // too far behind, drop the time we cannot catch up on
+            m_accumulator = duration(0);
+        }
+        return steps;
+    }
+
+    /**
+     * @brief alpha
+     * @return
+     *
+     * The fraction of a step which has not been simulated yet.
+     */
+    double alpha() const
+    {
+        return m_accumulator / m_timestep;
+    }
+
+    /**
+     * @brief reset
+     *
+     * Clears the accumulated time. The next call to advance()
+     * starts measuring from that point.
+     */
+    void reset()
+    {
+        m_started     = false;
+        m_accumulator = duration(0);
+    }
+
+protected:
+    duration               m_timestep    = duration(0);
+    duration               m_accumulator = duration(0);
+    uint32_t               m_maxSteps    = 8;
+    bool                   m_started     = false;
+    clock_type::time_point m_last;
+};
+
+}
+
+#endif
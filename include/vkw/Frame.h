@@ -2,16 +2,61 @@
 #define QTSDL_VULKAN_FRAME_H
 
 #include "vulkan_include.h"
+#include "FrameCommandPool.h"
+#include <vector>
+#include <array>
 
 namespace vkw
 {
+
+/**
+ * @brief The SemaphoreSubmit struct
+ *
+ * A semaphore to wait on or signal when submitting a frame.
+ * The stageMask uses the synchronization2 stage flags. If the
+ * device does not have synchronization2 enabled, the stage mask
+ * is converted to the legacy VkPipelineStageFlags.
+ */
+struct SemaphoreSubmit
+{
+    VkSemaphore           semaphore = VK_NULL_HANDLE;
+    VkPipelineStageFlags2 stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    uint64_t              value     = 0; // the value to wait on/signal if this is a timeline semaphore
+};
+
+/**
+ * @brief The FrameSubmitInfo struct
+ *
+ * Additional work which should be submitted together with a frame
+ * in a single queue submission.
+ */
+struct FrameSubmitInfo
+{
+    std::vector<VkCommandBuffer> commandBuffers;   // submitted before the frame's command buffer
+    std::vector<SemaphoreSubmit> waitSemaphores;   // waited on in addition to the swapchain image semaphore
+    std::vector<SemaphoreSubmit> signalSemaphores; // signalled in addition to the render complete semaphore
+
+    // the stage which waits for the swapchain image to become available.
+    // Any earlier stages of the frame can start executing before the image is acquired.
+    VkPipelineStageFlags2        swapchainWaitStage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+    // clears the lists, but keeps their memory around
+    void clear()
+    {
+        commandBuffers.clear();
+        waitSemaphores.clear();
+        signalSemaphores.clear();
+    }
+};
+
 struct Frame
 {
     uint32_t         swapchainIndex;
+    uint32_t         slotIndex = 0; // which slot of the frames-in-flight ring the command buffer/pool, fence and semaphores belong to
+    uint64_t         frameNumber = 0; // monotonically increasing number of this frame, starting at 1
     VkCommandBuffer  commandBuffer = VK_NULL_HANDLE; // the command buffer to record. THis buffer is automatically reset
                                                      //  when acquireFrame() is called. If you need more command buffers
-                                                     //  you can allocate it from the commandPool. You will need
-                                                     //  to manage these extra buffers yourself.
+                                                     //  use allocatePrimaryCommandBuffer()/allocateSecondaryCommandBuffer().
 
     VkCommandPool    commandPool         = VK_NULL_HANDLE;   // The command pool for this frame. Do not RESET this pool
     VkFramebuffer    framebuffer         = VK_NULL_HANDLE;
@@ -30,6 +75,18 @@ struct Frame
                                               //   submitted your last command buffer.
 
     VkFence          fence = VK_NULL_HANDLE;                   // the fence you should trigger when submitting this frame
+                                                               //   This is VK_NULL_HANDLE when the timeline frame scheduler is used
+    VkSemaphore      frameTimelineSemaphore = VK_NULL_HANDLE;  // the timeline semaphore which is signalled with frameNumber
+                                                               //   when this frame completes. Only used by the timeline frame scheduler
+
+    bool             imagelessFramebuffer = false; // the framebuffer is imageless, the image views are given in beginRenderPass()
+
+    PFN_vkCmdBeginRendering cmdBeginRendering = nullptr; // set when dynamic rendering is used, renderPass and framebuffer are VK_NULL_HANDLE
+    PFN_vkCmdEndRendering   cmdEndRendering   = nullptr;
+
+    FrameCommandPool * frameCommandPool       = nullptr; // the pool the extra command buffers are allocated from. nullptr when used with Qt
+    FrameCommandPool * threadCommandPools     = nullptr; // one pool per recording thread, at least 1. See SurfaceInitilizationInfo2::commandThreadCount
+    uint32_t           threadCommandPoolCount = 0;
 
     VkClearColorValue        clearColor;
     VkClearDepthStencilValue clearDepth;
@@ -46,8 +103,152 @@ struct Frame
         vkEndCommandBuffer(commandBuffer);
     }
 
+    /**
+     * @brief allocatePrimaryCommandBuffer
+     * @return
+     *
+     * Returns an additional primary command buffer for this frame. The
+     * buffer is owned by the frame and is recycled automatically when
+     * the frame slot is reused, do not free it. Only call this from
+     * the thread which is recording the frame.
+     */
+    VkCommandBuffer allocatePrimaryCommandBuffer() const
+    {
+        if( !frameCommandPool )
+        {
+            throw std::runtime_error("This frame does not have a command buffer allocator");
+        }
+        return frameCommandPool->allocatePrimary();
+    }
+
+    /**
+     * @brief allocateSecondaryCommandBuffer
+     * @return
+     *
+     * Same as allocatePrimaryCommandBuffer() but returns a
+     * secondary command buffer.
+     */
+    VkCommandBuffer allocateSecondaryCommandBuffer() const
+    {
+        if( !frameCommandPool )
+        {
+            throw std::runtime_error("This frame does not have a command buffer allocator");
+        }
+        return frameCommandPool->allocateSecondary();
+    }
+
+    /**
+     * @brief beginSecondaryCommandBuffer
+     * @param threadIndex
+     * @return
+     *
+     * Returns a secondary command buffer allocated from the command pool
+     * of threadIndex which has been begun so that it continues the
+     * default render pass. Each thread must only use its own index.
+     *
+     * Call vkEndCommandBuffer() when you are done recording and then
+     * executeSecondaryCommandBuffers() from the primary command buffer
+     * after the render pass was begun with
+     * VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+     */
+    VkCommandBuffer beginSecondaryCommandBuffer(uint32_t threadIndex) const
+    {
+        if( threadIndex >= threadCommandPoolCount )
+        {
+            throw std::runtime_error("Thread index is larger than the number of command threads");
+        }
+        auto cmd = threadCommandPools[threadIndex].allocateSecondary();
+        beginSecondaryCommandBuffer(cmd,
+                                    VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+                                    framebuffer);
+        return cmd;
+    }
+
+    /**
+     * @brief beginSecondaryCommandBuffer
+     * @param cmd
+     * @param usage
+     * @param inheritedFramebuffer - can be VK_NULL_HANDLE if the command buffer is
+     *                               executed with more than one framebuffer
+     *
+     * Begins a secondary command buffer so that it inherits
+     * this frame's render pass (or the attachment formats when using
+     * dynamic rendering).
+     */
+    void beginSecondaryCommandBuffer(VkCommandBuffer cmd, VkCommandBufferUsageFlags usage, VkFramebuffer inheritedFramebuffer) const
+    {
+        VkCommandBufferInheritanceInfo inheritanceInfo = {};
+        inheritanceInfo.sType       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass  = renderPass;
+        inheritanceInfo.subpass     = 0;
+        inheritanceInfo.framebuffer = inheritedFramebuffer;
+
+        // with dynamic rendering, the attachment formats are inherited instead
+        VkCommandBufferInheritanceRenderingInfo renderingInfo = {};
+        if( usingDynamicRendering() )
+        {
+            renderingInfo.sType                   = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+            renderingInfo.colorAttachmentCount    = 1;
+            renderingInfo.pColorAttachmentFormats = &swapchainFormat;
+            renderingInfo.depthAttachmentFormat   = depthImage == VK_NULL_HANDLE ? VK_FORMAT_UNDEFINED : depthFormat;
+            renderingInfo.stencilAttachmentFormat = depthImage != VK_NULL_HANDLE && hasStencilComponent(depthFormat) ? depthFormat : VK_FORMAT_UNDEFINED;
+            renderingInfo.rasterizationSamples    = VK_SAMPLE_COUNT_1_BIT;
+            inheritanceInfo.pNext                 = &renderingInfo;
+        }
+
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags            = usage;
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+        vkBeginCommandBuffer(cmd, &beginInfo);
+    }
+
+    /**
+     * @brief executeSecondaryCommandBuffers
+     * @param cmd
+     *
+     * Executes all the secondary command buffers which were handed
+     * out by beginSecondaryCommandBuffer() this frame. They are
+     * executed in order of the thread index, and then in the order
+     * they were requested.
+     */
+    void executeSecondaryCommandBuffers(VkCommandBuffer cmd) const
+    {
+        for(uint32_t i=0;i<threadCommandPoolCount;i++)
+        {
+            auto & p = threadCommandPools[i];
+            if( p.secondaryUsedCount > 0 )
+            {
+                vkCmdExecuteCommands(cmd, static_cast<uint32_t>(p.secondaryUsedCount), p.secondaryCommandBuffers.data());
+            }
+        }
+    }
+
     void beginRenderPass( VkCommandBuffer cmd )
     {
+        beginRenderPass(cmd, VK_SUBPASS_CONTENTS_INLINE);
+    }
+
+    bool usingDynamicRendering() const
+    {
+        return renderPass == VK_NULL_HANDLE && cmdBeginRendering != nullptr;
+    }
+
+    static bool hasStencilComponent(VkFormat format)
+    {
+        return format == VK_FORMAT_D32_SFLOAT_S8_UINT ||
+               format == VK_FORMAT_D24_UNORM_S8_UINT  ||
+               format == VK_FORMAT_D16_UNORM_S8_UINT;
+    }
+
+    void beginRenderPass( VkCommandBuffer cmd, VkSubpassContents contents )
+    {
+        if( usingDynamicRendering() )
+        {
+            _beginRendering(cmd, contents);
+            return;
+        }
+
         VkRenderPassBeginInfo render_pass_info = {};
         render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
         render_pass_info.renderPass        = renderPass;
@@ -56,19 +257,135 @@ struct Frame
         render_pass_info.renderArea.extent = swapchainSize;
         render_pass_info.clearValueCount   = 1;
 
-        std::vector<VkClearValue> clearValues(2);
+        std::array<VkClearValue, 2> clearValues;
         clearValues[0].color = clearColor;
         clearValues[1].depthStencil = clearDepth;
 
         render_pass_info.clearValueCount = depthImage==VK_NULL_HANDLE? 1 : static_cast<uint32_t>(clearValues.size());
         render_pass_info.pClearValues = clearValues.data();
 
-        vkCmdBeginRenderPass(cmd, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+        // an imageless framebuffer is shared by all the swapchain
+        // images, so pass this frame's image views
+        std::array<VkImageView, 2> attachments = { swapchainImageView, depthImageView };
+        VkRenderPassAttachmentBeginInfo attachmentInfo = {};
+        if( imagelessFramebuffer )
+        {
+            attachmentInfo.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_ATTACHMENT_BEGIN_INFO;
+            attachmentInfo.attachmentCount = depthImage==VK_NULL_HANDLE? 1 : 2;
+            attachmentInfo.pAttachments    = attachments.data();
+            render_pass_info.pNext         = &attachmentInfo;
+        }
+
+        vkCmdBeginRenderPass(cmd, &render_pass_info, contents);
     }
     void endRenderPass(VkCommandBuffer cmd)
     {
+        if( usingDynamicRendering() )
+        {
+            _endRendering(cmd);
+            return;
+        }
         vkCmdEndRenderPass(cmd);
     }
+
+protected:
+    /**
+     * Begins dynamic rendering on the swapchain image and
+     * depth image. This performs the layout transitions the
+     * default render pass would do implicitly.
+     */
+    void _beginRendering( VkCommandBuffer cmd, VkSubpassContents contents )
+    {
+        bool hasDepth = depthImage != VK_NULL_HANDLE;
+
+        std::array<VkImageMemoryBarrier, 2> barriers = {};
+        barriers[0].sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barriers[0].srcAccessMask       = 0;
+        barriers[0].dstAccessMask       = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        barriers[0].oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[0].newLayout           = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].image               = swapchainImage;
+        barriers[0].subresourceRange    = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+        // the depth image is shared by all the frames in flight, the
+        // previous frame's depth writes must finish before it is cleared
+        barriers[1] = barriers[0];
+        barriers[1].srcAccessMask       = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barriers[1].dstAccessMask       = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barriers[1].newLayout           = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        barriers[1].image               = depthImage;
+        barriers[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | (hasStencilComponent(depthFormat) ? VK_IMAGE_ASPECT_STENCIL_BIT : 0);
+
+        vkCmdPipelineBarrier(cmd,
+                             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                             0,
+                             0, nullptr,
+                             0, nullptr,
+                             hasDepth ? 2u : 1u, barriers.data());
+
+        VkRenderingAttachmentInfo colorAttachment = {};
+        colorAttachment.sType             = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        colorAttachment.imageView         = swapchainImageView;
+        colorAttachment.imageLayout       = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.loadOp            = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.storeOp           = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.clearValue.color  = clearColor;
+
+        VkRenderingAttachmentInfo depthAttachment = {};
+        depthAttachment.sType                   = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        depthAttachment.imageView               = depthImageView;
+        depthAttachment.imageLayout             = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.loadOp                  = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp                 = VK_ATTACHMENT_STORE_OP_STORE;
+        depthAttachment.clearValue.depthStencil = clearDepth;
+
+        VkRenderingAttachmentInfo stencilAttachment = depthAttachment;
+        stencilAttachment.storeOp               = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+        VkRenderingInfo renderingInfo = {};
+        renderingInfo.sType                = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        renderingInfo.flags                = contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0;
+        renderingInfo.renderArea.offset    = {0, 0};
+        renderingInfo.renderArea.extent    = swapchainSize;
+        renderingInfo.layerCount           = 1;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachments    = &colorAttachment;
+        renderingInfo.pDepthAttachment     = hasDepth ? &depthAttachment : nullptr;
+        renderingInfo.pStencilAttachment   = hasDepth && hasStencilComponent(depthFormat) ? &stencilAttachment : nullptr;
+
+        cmdBeginRendering(cmd, &renderingInfo);
+    }
+
+    /**
+     * Ends dynamic rendering and transitions the
+     * swapchain image so that it can be presented.
+     */
+    void _endRendering( VkCommandBuffer cmd )
+    {
+        cmdEndRendering(cmd);
+
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask       = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        barrier.dstAccessMask       = 0;
+        barrier.oldLayout           = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        barrier.newLayout           = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image               = swapchainImage;
+        barrier.subresourceRange    = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+        vkCmdPipelineBarrier(cmd,
+                             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0,
+                             0, nullptr,
+                             0, nullptr,
+                             1, &barrier);
+    }
 };
 }
 
@@ -0,0 +1,129 @@
+#ifndef VKW_FRAME_COMMAND_POOL_H
+#define VKW_FRAME_COMMAND_POOL_H
+
+#include "vulkan_include.h"
+#include <vector>
+#include <stdexcept>
+
+namespace vkw
+{
+
+/**
+ * @brief The FrameCommandPool struct
+ *
+ * A transient command pool which belongs to a single frame slot.
+ * Every frame slot has one for the main thread, and one for each
+ * recording thread, since a VkCommandPool cannot be used by two threads
+ * at the same time.
+ *
+ * Command buffers handed out by this pool are kept and reused
+ * once the frame slot comes around again. The whole pool is reset
+ * at once with vkResetCommandPool when the next frame using this
+ * slot is acquired, which is cheaper than resetting the command
+ * buffers individually.
+ */
+struct FrameCommandPool
+{
+    VkDevice                     device      = VK_NULL_HANDLE;
+    VkCommandPool                commandPool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> primaryCommandBuffers;   // all the primary buffers allocated from this pool
+    std::vector<VkCommandBuffer> secondaryCommandBuffers; // all the secondary buffers allocated from this pool
+    size_t                       primaryUsedCount   = 0;  // the number of buffers handed out this frame
+    size_t                       secondaryUsedCount = 0;
+
+    void create(VkDevice d, uint32_t queueFamilyIndex)
+    {
+        device = d;
+
+        VkCommandPoolCreateInfo cmdC = {};
+        cmdC.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        cmdC.flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        cmdC.queueFamilyIndex = queueFamilyIndex;
+
+        if( VkResult::VK_SUCCESS != vkCreateCommandPool(device, &cmdC, nullptr, &commandPool) )
+        {
+            throw std::runtime_error("Failed to create command pool");
+        }
+    }
+
+    void destroy()
+    {
+        if( commandPool != VK_NULL_HANDLE )
+        {
+            // destroying the pool frees all of its command buffers
+            vkDestroyCommandPool(device, commandPool, nullptr);
+            commandPool = VK_NULL_HANDLE;
+        }
+        primaryCommandBuffers.clear();
+        secondaryCommandBuffers.clear();
+        primaryUsedCount   = 0;
+        secondaryUsedCount = 0;
+    }
+
+    /**
+     * @brief reset
+     *
+     * Resets all the command buffers which were allocated
+     * from this pool. Only call this once the GPU has
+     * finished executing them. Pools which did not hand out
+     * any buffers since the last reset are left alone.
+     */
+    void reset()
+    {
+        if( primaryUsedCount > 0 || secondaryUsedCount > 0 )
+        {
+            vkResetCommandPool(device, commandPool, 0);
+        }
+        primaryUsedCount   = 0;
+        secondaryUsedCount = 0;
+    }
+
+    /**
+     * @brief allocatePrimary
+     * @return
+     *
+     * Returns a primary command buffer which has not been used
+     * this frame. New buffers are only allocated if all of the
+     * previously allocated ones are in use.
+     */
+    VkCommandBuffer allocatePrimary()
+    {
+        return _next(primaryCommandBuffers, primaryUsedCount, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    }
+
+    /**
+     * @brief allocateSecondary
+     * @return
+     *
+     * Same as allocatePrimary() but for secondary command buffers.
+     */
+    VkCommandBuffer allocateSecondary()
+    {
+        return _next(secondaryCommandBuffers, secondaryUsedCount, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+    }
+
+protected:
+    VkCommandBuffer _next(std::vector<VkCommandBuffer> & buffers, size_t & usedCount, VkCommandBufferLevel level)
+    {
+        if( usedCount == buffers.size() )
+        {
+            VkCommandBufferAllocateInfo allocateInfo = {};
+            allocateInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocateInfo.commandPool        = commandPool;
+            allocateInfo.level              = level;
+            allocateInfo.commandBufferCount = 1;
+
+            VkCommandBuffer cmd = VK_NULL_HANDLE;
+            if( VkResult::VK_SUCCESS != vkAllocateCommandBuffers(device, &allocateInfo, &cmd) )
+            {
+                throw std::runtime_error("Failed to allocate command buffer");
+            }
+            buffers.push_back(cmd);
+        }
+        return buffers[usedCount++];
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,393 @@
+#ifndef VKW_FRAME_COROUTINES_H
+#define VKW_FRAME_COROUTINES_H
+
+#include "vulkan_include.h"
+#include <cstdint>
+#include <vector>
+#include <exception>
+
+#if defined(__has_include)
+    #if __has_include(<coroutine>) && __cplusplus >= 202002L
+        #define VKW_HAS_COROUTINES 1
+    #endif
+#endif
+
+#if defined(VKW_HAS_COROUTINES)
+#include <coroutine>
+#endif
+
+namespace vkw
+{
+
+/**
+ * @brief The CoroutineScheduler class
+ *
+ * Lets frame logic co_await GPU work instead of polling fences
+ * or blocking. The widgets call resume() once per frame, after
+ * the next frame has been acquired, which resumes every coroutine
+ * whose condition has been met. swapchainRebuilt() is called
+ * after initSwapChainResources().
+ *
+ * All coroutines are resumed on the render thread.
+ *
+ * Coroutines require C++20, but this class is the same in every
+ * language mode, so that translation units compiled as C++17 and
+ * C++20 agree on the layout of the Application. The suspended
+ * coroutines are stored as type erased Handles and the awaiters
+ * only touch std::coroutine_handle in templates, which are never
+ * instantiated without C++20.
+ *
+ * @code
+ * vkw::FrameTask readback(vkw::Frame & frame)
+ * {
+ *     // ... record a copy into a host visible buffer
+ *     co_await coroutines().frameCompleted(frame.frameNumber);
+ *     // the copy has finished, read the buffer
+ * }
+ * @endcode
+ */
+class CoroutineScheduler
+{
+public:
+    /**
+     * @brief The Handle struct
+     *
+     * A suspended coroutine.
+     */
+    struct Handle
+    {
+        void  *address = nullptr;
+        void (*resumeFunction)(void*)  = nullptr;
+        void (*destroyFunction)(void*) = nullptr;
+
+        void resume() const
+        {
+            resumeFunction(address);
+        }
+        void destroy() const
+        {
+            destroyFunction(address);
+        }
+
+        template<typename coroutine_handle_t>
+        static Handle from(coroutine_handle_t h)
+        {
+            Handle r;
+            r.address         = h.address();
+            r.resumeFunction  = [](void * p) { coroutine_handle_t::from_address(p).resume(); };
+            r.destroyFunction = [](void * p) { coroutine_handle_t::from_address(p).destroy(); };
+            return r;
+        }
+    };
+
+    struct FrameAwaiter
+    {
+        CoroutineScheduler * scheduler;
+        uint64_t             frameNumber;
+
+        bool await_ready() const noexcept
+        {
+            return scheduler->m_completedFrameNumber >= frameNumber;
+        }
+        template<typename coroutine_handle_t>
+        void await_suspend(coroutine_handle_t h)
+        {
+            scheduler->m_frameWaiters.push_back({frameNumber, Handle::from(h)});
+        }
+        void await_resume() const noexcept
+        {
+        }
+    };
+
+    struct FenceAwaiter
+    {
+        CoroutineScheduler * scheduler;
+        VkFence              fence;
+
+        bool await_ready() const
+        {
+            return vkGetFenceStatus(scheduler->m_device, fence) == VK_SUCCESS;
+        }
+        template<typename coroutine_handle_t>
+        void await_suspend(coroutine_handle_t h)
+        {
+            scheduler->m_fenceWaiters.push_back({fence, Handle::from(h)});
+        }
+        void await_resume() const noexcept
+        {
+        }
+    };
+
+    struct EventAwaiter
+    {
+        std::vector<Handle> * waiters;
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+        template<typename coroutine_handle_t>
+        void await_suspend(coroutine_handle_t h)
+        {
+            waiters->push_back(Handle::from(h));
+        }
+        void await_resume() const noexcept
+        {
+        }
+    };
+
+    ~CoroutineScheduler()
+    {
+        destroy();
+    }
+
+    void init(VkDevice device)
+    {
+        m_device = device;
+    }
+
+    /**
+     * @brief frameCompleted
+     * @param frameNumber
+     *
+     * co_await this to resume once the GPU has
+     * finished executing frameNumber.
+     */
+    FrameAwaiter frameCompleted(uint64_t frameNumber)
+    {
+        return FrameAwaiter{this, frameNumber};
+    }
+
+    /**
+     * @brief fenceSignalled
+     * @param fence
+     *
+     * co_await this to resume once fence has been signalled.
+     */
+    FenceAwaiter fenceSignalled(VkFence fence)
+    {
+        return FenceAwaiter{this, fence};
+    }
+
+    /**
+     * @brief nextFrame
+     *
+     * co_await this to resume at the start of the next frame.
+     */
+    EventAwaiter nextFrame()
+    {
+        return EventAwaiter{&m_nextFrameWaiters};
+    }
+
+    /**
+     * @brief swapchainRebuilt
+     *
+     * co_await this to resume after the swapchain has been
+     * rebuilt and initSwapChainResources() has been called.
+     */
+    EventAwaiter swapchainRebuilt()
+    {
+        return EventAwaiter{&m_swapchainWaiters};
+    }
+
+    /**
+     * @brief resume
+     * @param completedFrameNumber
+     *
+     * Resumes the coroutines waiting for the next frame, for a
+     * frame which has completed or for a fence which has been signalled.
+     * Exceptions thrown by the coroutines are kept until
+     * rethrowException() is called.
+     */
+    void resume(uint64_t completedFrameNumber)
+    {
+        m_completedFrameNumber = completedFrameNumber;
+
+        // the coroutines may add new waiters while they are resumed,
+        // so collect the ready ones first
+        m_ready.swap(m_nextFrameWaiters);
+
+        for(size_t i=0; i < m_frameWaiters.size(); )
+        {
+            if( m_frameWaiters[i].frameNumber <= completedFrameNumber )
+            {
+                m_ready.push_back(m_frameWaiters[i].handle);
+                m_frameWaiters[i] = m_frameWaiters.back();
+                m_frameWaiters.pop_back();
+            }
+            else
+            {
+                ++i;
+            }
+        }
+        for(size_t i=0; i < m_fenceWaiters.size(); )
+        {
+            if( vkGetFenceStatus(m_device, m_fenceWaiters[i].fence) == VK_SUCCESS )
+            {
+                m_ready.push_back(m_fenceWaiters[i].handle);
+                m_fenceWaiters[i] = m_fenceWaiters.back();
+                m_fenceWaiters.pop_back();
+            }
+            else
+            {
+                ++i;
+            }
+        }
+        _resumeReady();
+    }
+
+    /**
+     * @brief notifySwapchainRebuilt
+     *
+     * Called by the widgets after initSwapChainResources().
+     */
+    void notifySwapchainRebuilt()
+    {
+        m_ready.swap(m_swapchainWaiters);
+        _resumeReady();
+    }
+
+    /**
+     * @brief rethrowException
+     *
+     * Rethrows the first exception thrown by a coroutine on this
+     * thread since the last call. The widgets call this once the
+     * frame has been submitted, so that the exception does not
+     * leave a frame acquired but never submitted.
+     */
+    void rethrowException()
+    {
+        auto & e = pendingException();
+        if( e )
+        {
+            auto ex = e;
+            e = nullptr;
+            std::rethrow_exception(ex);
+        }
+    }
+
+    bool empty() const
+    {
+        return m_frameWaiters.empty() && m_fenceWaiters.empty() &&
+               m_nextFrameWaiters.empty() && m_swapchainWaiters.empty();
+    }
+
+    /**
+     * @brief destroy
+     *
+     * Destroys all the coroutines which are still suspended.
+     */
+    void destroy()
+    {
+        for(auto & w : m_frameWaiters)     w.handle.destroy();
+        for(auto & w : m_fenceWaiters)     w.handle.destroy();
+        for(auto & h : m_nextFrameWaiters) h.destroy();
+        for(auto & h : m_swapchainWaiters) h.destroy();
+        m_frameWaiters.clear();
+        m_fenceWaiters.clear();
+        m_nextFrameWaiters.clear();
+        m_swapchainWaiters.clear();
+    }
+
+    /**
+     * @brief pendingException
+     * @return
+     *
+     * The exception of a coroutine which finished by throwing,
+     * waiting to be rethrown by rethrowException(). Only the
+     * first one is kept.
+     */
+    static std::exception_ptr & pendingException()
+    {
+        static thread_local std::exception_ptr e;
+        return e;
+    }
+
+protected:
+    struct FrameWaiter
+    {
+        uint64_t frameNumber;
+        Handle   handle;
+    };
+    struct FenceWaiter
+    {
+        VkFence fence;
+        Handle  handle;
+    };
+
+    void _resumeReady()
+    {
+        for(size_t i=0; i < m_ready.size(); i++)
+        {
+            // take the handle out of the list first, a handle
+            // must never be resumed twice
+            auto h = m_ready[i];
+            m_ready[i] = Handle();
+            h.resume();
+        }
+        m_ready.clear();
+    }
+
+    VkDevice                 m_device = VK_NULL_HANDLE;
+    uint64_t                 m_completedFrameNumber = 0;
+    std::vector<FrameWaiter> m_frameWaiters;
+    std::vector<FenceWaiter> m_fenceWaiters;
+    std::vector<Handle>      m_nextFrameWaiters;
+    std::vector<Handle>      m_swapchainWaiters;
+    std::vector<Handle>      m_ready;
+};
+
+#if defined(VKW_HAS_COROUTINES)
+
+/**
+ * @brief The FrameTask struct
+ *
+ * The return type of a coroutine which is driven by the
+ * CoroutineScheduler. The coroutine starts running immediately
+ * when it is called and frees itself once it returns.
+ *
+ * Exceptions thrown by the coroutine are stored and rethrown
+ * by CoroutineScheduler::rethrowException() on the same thread,
+ * ie: out of the widget's exec() loop, once the frame has
+ * been submitted.
+ */
+struct FrameTask
+{
+    struct promise_type
+    {
+        std::exception_ptr exception;
+
+        FrameTask get_return_object() noexcept
+        {
+            return {};
+        }
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept
+        {
+            // the frame is destroyed after this, so
+            // hand the exception over to the scheduler
+            auto & pending = CoroutineScheduler::pendingException();
+            if( exception && !pending )
+            {
+                pending = std::move(exception);
+            }
+            return {};
+        }
+        void return_void() noexcept
+        {
+        }
+        void unhandled_exception() noexcept
+        {
+            exception = std::current_exception();
+        }
+    };
+};
+
+#endif
+
+}
+
+#endif
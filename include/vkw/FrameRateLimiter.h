@@ -0,0 +1,169 @@
+#ifndef VKW_FRAME_RATE_LIMITER_H
+#define VKW_FRAME_RATE_LIMITER_H
+
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <thread>
+
+namespace vkw
+{
+
+/**
+ * @brief The FrameRateLimiter class
+ *
+ * Caps the frame rate by waiting until the start of the next
+ * frame interval. The OS sleep is only accurate to a millisecond
+ * or so, so it sleeps until spinThreshold before the deadline and
+ * then spins for the rest of the interval.
+ *
+ * The deadlines are spaced exactly one interval apart, so that
+ * small errors do not accumulate. If a frame takes longer than an
+ * interval, the schedule restarts from the current time instead of
+ * trying to catch up.
+ *
+ * The jitter is how late wait() returned after the deadline. Frames
+ * which arrive after their deadline are recorded as well, so late
+ * frames show up in the statistics.
+ */
+class FrameRateLimiter
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+    using duration   = std::chrono::duration<double, std::nano>;
+
+    struct Statistics
+    {
+        duration lastJitter    = duration(0);
+        duration averageJitter = duration(0);
+        duration maxJitter     = duration(0);
+        uint64_t frameCount    = 0;
+    };
+
+    /**
+     * @brief setTargetFrameRate
+     * @param fps - 0 disables the limiter
+     */
+    void setTargetFrameRate(double fps)
+    {
+        m_targetFrameRate = std::max(0.0, fps);
+        m_hasDeadline     = false;
+    }
+    double getTargetFrameRate() const
+    {
+        return m_targetFrameRate;
+    }
+    bool isEnabled() const
+    {
+        return m_targetFrameRate > 0.0;
+    }
+
+    /**
+     * @brief setSpinThreshold
+     *
+     * How long before the deadline to stop sleeping and start
+     * spinning. Larger values are more precise but use more CPU.
+     */
+    void setSpinThreshold(duration d)
+    {
+        m_spinThreshold = d;
+    }
+    duration getSpinThreshold() const
+    {
+        return m_spinThreshold;
+    }
+
+    /**
+     * @brief sleepTime
+     * @return
+     *
+     * Returns how long the caller can block, eg: waiting
+     * for events, before it needs to call wait().
+     */
+    std::chrono::milliseconds sleepTime(clock_type::time_point now = clock_type::now()) const
+    {
+        if( !isEnabled() || !m_hasDeadline )
+            return std::chrono::milliseconds(0);
+
+        auto remaining = duration(m_deadline - now) - m_spinThreshold;
+        if( remaining.count() <= 0 )
+            return std::chrono::milliseconds(0);
+        return std::chrono::floor<std::chrono::milliseconds>(remaining);
+    }
+
+    /**
+     * @brief wait
+     *
+     * Blocks until the start of the next frame interval.
+     */
+    void wait()
+    {
+        if( !isEnabled() )
+            return;
+
+        auto interval = std::chrono::duration_cast<clock_type::duration>( std::chrono::duration<double>(1.0 / m_targetFrameRate) );
+        auto now      = clock_type::now();
+
+        if( !m_hasDeadline || now > m_deadline + interval )
+        {
+            // first frame, or we fell behind
+            if( m_hasDeadline )
+                _record( duration(now - m_deadline) );
+            m_deadline    = now + interval;
+            m_hasDeadline = true;
+            return;
+        }
+
+        if( now >= m_deadline )
+        {
+            // the frame took most of the interval, there is
+            // nothing to wait for
+            _record( duration(now - m_deadline) );
+            m_deadline += interval;
+            return;
+        }
+
+        auto coarse = duration(m_deadline - now) - m_spinThreshold;
+        if( coarse.count() > 0 )
+        {
+            std::this_thread::sleep_for( std::chrono::duration_cast<clock_type::duration>(coarse) );
+        }
+        while( (now = clock_type::now()) < m_deadline )
+        {
+            // spin
+        }
+
+        _record( duration(now - m_deadline) );
+        m_deadline += interval;
+    }
+
+    Statistics const & getStatistics() const
+    {
+        return m_statistics;
+    }
+    void resetStatistics()
+    {
+        m_statistics = Statistics();
+    }
+
+protected:
+    void _record(duration jitter)
+    {
+        auto & S = m_statistics;
+        S.lastJitter    = jitter;
+        S.maxJitter     = std::max(S.maxJitter, jitter);
+        S.averageJitter = S.frameCount == 0 ? jitter : S.averageJitter + (jitter - S.averageJitter) * m_smoothing;
+        S.frameCount++;
+    }
+
+    double                 m_targetFrameRate = 0.0;
+    duration               m_spinThreshold   = std::chrono::milliseconds(2);
+    double                 m_smoothing       = 0.1;
+    clock_type::time_point m_deadline;
+    bool                   m_hasDeadline     = false;
+    Statistics             m_statistics;
+};
+
+}
+
+#endif
@@ -1,12 +1,12 @@
 #ifndef VKW_GLFW_VULKAN_WIDGET3_H
 #define VKW_GLFW_VULKAN_WIDGET3_H
 
-#include "VKWVulkanWindow.h"
+#include "VulkanWidgetBase.h"
 #include "Adapters/GLFWVulkanWindowAdapter.h"
-#include "VulkanApplication.h"
-#include "Frame.h"
+#include "SPSCQueue.h"
 #include <iostream>
-#include <thread>
+#include <deque>
+#include <chrono>
 
 namespace vkw {
 
@@ -19,8 +19,9 @@ namespace vkw {
  * so that they can be used interchangeably without
  * much modification.
  */
-class GLFWVulkanWidget : public VKWVulkanWindow
+class GLFWVulkanWidget : public VulkanWidgetBase<GLFWVulkanWidget>
 {
+    friend class VulkanWidgetBase<GLFWVulkanWidget>;
 public:
     struct CreateInfo
     {
@@ -63,33 +64,6 @@ public:
         app->releaseResources();
     }
 
-    void render( Application * app)
-    {
-        auto fr = acquireNextFrame();
-
-        fr.beginCommandBuffer();
-
-        app->m_renderNextFrame = false;
-        app->render(fr);
-
-        fr.endCommandBuffer();
-        frameReady(fr);
-    }
-
-    void _initSwapchainVars(Application * app)
-    {
-        app->m_swapChainSize       = getSwapchainExtent();
-        app->m_swapChainFormat     = getSwapchainFormat();
-        app->m_swapChainDepthFormat= getDepthFormat();
-        app->m_concurrentFrameCount= static_cast<uint32_t>(m_swapchainFrameBuffers.size());
-        app->m_defaultRenderPass   = m_renderPass;
-
-        app->m_swapchainImageViews = m_swapchainImageViews;
-        app->m_swapchainImages = m_swapchainImages;
-
-        app->m_currentSwapchainIndex=0;
-    }
-
     int exec(Application * app)
     {
         return exec(app, [](){});
@@ -100,70 +74,156 @@ public:
      *
      * Similar to Qt's app.exec(). this will
      * loop until the the windows is closed
+     *
+     * If threaded rendering is enabled, the events are polled
+     * on the calling thread and mainLoop and the Application
+     * are called from the render thread. GLFW input callbacks
+     * are still called on the calling thread.
      */
-    template<typename SDL_MAIN_LOOP_CALLABLE>
-    int exec(Application * app, SDL_MAIN_LOOP_CALLABLE && mainLoop)
+    template<typename MAIN_LOOP_CALLABLE>
+    int exec(Application * app, MAIN_LOOP_CALLABLE && mainLoop)
     {
-        app->m_device         = getDevice();
-        app->m_physicalDevice = getPhysicalDevice();
-        app->m_instance       = getInstance();
-
-        app->m_graphicsQueue  = getGraphicsQueue();
-        app->m_presentQueue   = getPresentQueue();
-        app->m_graphicsQueueIndex = getGraphicsQueueIndex();
-        app->m_presentQueueIndex  = getPresentQueueIndex();
-
-        _initSwapchainVars(app);
-
-        app->initResources();
-        app->initSwapChainResources();
-
-        while( !glfwWindowShouldClose(m_adapter->m_window) )
+        if( isThreadedRendering() )
         {
-            glfwPollEvents();
-            bool resize = m_adapter->requiresResize();
+            return _execThreaded(app, mainLoop);
+        }
 
-            if( app->shouldQuit() )
+        auto pollEvents = [this](Application *, std::chrono::milliseconds timeout, bool & resize)
+        {
+            if( timeout.count() > 0 )
             {
-                break;
+                glfwWaitEventsTimeout( std::chrono::duration<double>(timeout).count() );
             }
-            if(resize)
+            else
             {
-                app->releaseSwapChainResources();
-                rebuildSwapchain();
-
-                _initSwapchainVars(app);
-                app->initSwapChainResources();
-
-                m_adapter->clearRequireResize();
+                glfwPollEvents();
             }
+            _trackWindowState();
+            resize = m_adapter->requiresResize();
+            m_adapter->clearRequireResize();
+            return !glfwWindowShouldClose(m_adapter->m_window);
+        };
+        return _exec(app, pollEvents, mainLoop);
+    }
 
+protected:
+    /**
+     * @brief The WindowEvent struct
+     *
+     * GLFW reports events through callbacks on the main thread,
+     * the ones the render loop needs are forwarded as WindowEvents.
+     */
+    struct WindowEvent
+    {
+        enum class Type
+        {
+            Resize,
+            Close,
+            StateChanged // minimized or focus changed
+        };
+        Type       type   = Type::Resize;
+        VkExtent2D extent = {0,0};
+    };
 
-            if( app->shouldRender() )
-            {
-                mainLoop();
-                render(app);
-            }
-        }
-
-        app->releaseSwapChainResources();
-        app->releaseResources();
-        destroy();
+    /**
+     * @brief _trackWindowState
+     *
+     * The GLFW callbacks record the state on the main thread,
+     * this can be called from either thread.
+     */
+    void _trackWindowState()
+    {
+        _setWindowMinimized(m_adapter->isIconified());
+        m_windowFocused = m_adapter->isFocused();
+    }
 
-        return 0;
+    /**
+     * @brief _postWakeEvent
+     *
+     * Unblocks glfwWaitEventsTimeout, called from any thread.
+     */
+    void _postWakeEvent()
+    {
+        glfwPostEmptyEvent();
     }
 
     /**
-     * @brief frameReady
+     * @brief _execThreaded
      *
-     * Call this function to present the frame.
+     * The calling thread only pumps the GLFW events and forwards
+     * resize and close requests to the render thread through a
+     * lock-free queue.
      */
-    void frameReady(Frame & fr)
+    template<typename MAIN_LOOP_CALLABLE>
+    int _execThreaded(Application * app, MAIN_LOOP_CALLABLE && mainLoop)
     {
-        submitFrame(fr);
-        presentFrame(fr);
-        waitForPresent();
+        auto drain = [this](Application *, bool & resize)
+        {
+            bool closed = false;
+            WindowEvent E;
+            while( m_eventQueue.pop(E) )
+            {
+                resize |= E.type == WindowEvent::Type::Resize;
+                closed |= E.type == WindowEvent::Type::Close;
+            }
+            _trackWindowState();
+            return !closed;
+        };
+
+        std::deque<WindowEvent> pending;
+        bool closeSent     = false;
+        bool lastMinimized = false;
+        bool lastFocused   = true;
+        auto pump = [&]()
+        {
+            glfwWaitEventsTimeout(0.005);
+
+            if( m_adapter->requiresResize() )
+            {
+                m_adapter->clearRequireResize();
+                _cacheDrawableSize();
+
+                WindowEvent E;
+                E.type   = WindowEvent::Type::Resize;
+                E.extent = m_adapter->m_userPtr->windowExtent;
+                pending.push_back(E);
+            }
+            bool minimized = m_adapter->isIconified();
+            bool focused   = m_adapter->isFocused();
+            if( minimized != lastMinimized || focused != lastFocused )
+            {
+                WindowEvent E;
+                E.type = WindowEvent::Type::StateChanged;
+                pending.push_back(E);
+                lastMinimized = minimized;
+                lastFocused   = focused;
+            }
+            if( !closeSent && glfwWindowShouldClose(m_adapter->m_window) )
+            {
+                WindowEvent E;
+                E.type = WindowEvent::Type::Close;
+                pending.push_back(E);
+                closeSent = true;
+            }
+
+            // events which did not fit in the queue are kept
+            // until the render thread catches up.
+            bool forwarded = false;
+            while( !pending.empty() && m_eventQueue.push(pending.front()) )
+            {
+                pending.pop_front();
+                forwarded = true;
+            }
+            if( forwarded )
+            {
+                _notifyRenderThread();
+            }
+        };
+
+        return VulkanWidgetBase<GLFWVulkanWidget>::_execThreaded(app, drain, pump, mainLoop);
     }
+
+    SPSCQueue<WindowEvent, 64> m_eventQueue;
 };
 
 }
@@ -0,0 +1,651 @@
+#ifndef VKW_JOB_SYSTEM_H
+#define VKW_JOB_SYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace vkw
+{
+
+/**
+ * @brief The JobCounter struct
+ *
+ * Counts the number of jobs which have been submitted
+ * with this counter but have not finished yet. If one of
+ * the jobs throws, the first exception is kept and rethrown
+ * by JobSystem::wait().
+ */
+struct JobCounter
+{
+    std::atomic<uint32_t> count{0};
+    std::mutex            exceptionMutex;
+    std::exception_ptr    exception;
+
+    bool done() const
+    {
+        return count.load(std::memory_order_acquire) == 0;
+    }
+};
+
+/**
+ * @brief The JobSystem class
+ *
+ * A work-stealing thread pool. The system is started with a total
+ * number of threads: the thread which calls start() is thread 0 and
+ * threadCount-1 worker threads are created.
+ *
+ * Every thread has its own job queue. A thread pushes and pops
+ * jobs from the back of its own queue, and when it is empty, steals
+ * jobs from the front of the other threads' queues.
+ *
+ * Threads which wait for a JobCounter execute jobs while they wait,
+ * so the calling thread takes part in the work instead of blocking.
+ *
+ * workerIndex() returns the index of the calling thread in
+ * [0, getThreadCount()), which can be used with
+ * Frame::beginSecondaryCommandBuffer(threadIndex) and PerWorker<T>.
+ * The index belongs to this job system: threads which are not part
+ * of it get externalThread. They can submit jobs and wait for them,
+ * but do not execute any jobs themselves.
+ *
+ * The widgets start their job system with
+ * SurfaceInitilizationInfo2::commandThreadCount threads, so every
+ * thread has its own command pool for each frame.
+ */
+class JobSystem
+{
+public:
+    using job_function = std::function<void()>;
+
+    // returned by workerIndex() for threads which are
+    // not part of the job system
+    static constexpr uint32_t externalThread = 0xFFFFFFFFu;
+
+    JobSystem() = default;
+    JobSystem(JobSystem const &) = delete;
+    JobSystem & operator=(JobSystem const &) = delete;
+
+    ~JobSystem()
+    {
+        stop();
+    }
+
+    /**
+     * @brief start
+     * @param threadCount - the total number of threads, including
+     *                      the calling thread. If 0 or 1, no worker
+     *                      threads are created and all jobs are executed
+     *                      by the thread which waits for them.
+     */
+    void start(uint32_t threadCount)
+    {
+        if( !m_workers.empty() )
+        {
+            throw std::runtime_error("The job system has already been started");
+        }
+        threadCount = threadCount == 0 ? 1 : threadCount;
+
+        m_stop = false;
+        m_queues.clear();
+        for(uint32_t i=0; i < threadCount; i++)
+        {
+            m_queues.emplace_back(std::make_unique<Queue>());
+        }
+
+        m_ownerThread = std::this_thread::get_id();
+        for(uint32_t i=1; i < threadCount; i++)
+        {
+            m_workers.emplace_back([this, i]()
+            {
+                _worker() = Worker{this, i};
+                _workerLoop(i);
+            });
+        }
+    }
+
+    /**
+     * @brief stop
+     *
+     * Finishes all the queued jobs and joins the worker threads.
+     */
+    void stop()
+    {
+        if( m_workers.empty() )
+        {
+            // nothing was started, or no workers were created.
+            // make sure no job is left behind
+            while( !m_queues.empty() && _runOne(0) ) {}
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> L(m_sleepMutex);
+            m_stop = true;
+        }
+        m_sleepCondition.notify_all();
+
+        for(auto & w : m_workers)
+        {
+            w.join();
+        }
+        m_workers.clear();
+
+        while( _runOne(0) ) {}
+    }
+
+    /**
+     * @brief getThreadCount
+     * @return
+     *
+     * Returns the number of threads which can execute jobs,
+     * including the thread which started the job system.
+     */
+    uint32_t getThreadCount() const
+    {
+        return static_cast<uint32_t>(std::max<size_t>(1, m_queues.size()));
+    }
+
+    /**
+     * @brief workerIndex
+     * @return
+     *
+     * Returns the index of the calling thread in this job system.
+     * The thread which called start() is 0, the worker threads
+     * return [1, getThreadCount()). Every other thread, including
+     * the workers of other job systems, returns externalThread.
+     */
+    uint32_t workerIndex() const
+    {
+        auto & w = _worker();
+        if( w.system == this )
+            return w.index;
+        if( std::this_thread::get_id() == m_ownerThread )
+            return 0;
+        return externalThread;
+    }
+
+    /**
+     * @brief submit
+     * @param job
+     * @param counter - optional, incremented now and decremented
+     *                  once the job has finished.
+     *
+     * Queues a job on the calling thread's queue. Jobs
+     * submitted by external threads are queued on thread 0's
+     * queue.
+     *
+     * If the job throws, the exception is rethrown by wait(counter).
+     * If no counter was given, it is rethrown by the next wait().
+     */
+    void submit(job_function job, JobCounter * counter = nullptr)
+    {
+        if( m_queues.empty() )
+        {
+            throw std::runtime_error("The job system has not been started");
+        }
+        if( counter )
+        {
+            counter->count.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        auto index = workerIndex();
+        auto & q = *m_queues[ index == externalThread ? 0 : index ];
+        {
+            std::lock_guard<std::mutex> L(q.mutex);
+            q.jobs.push_back( Job{ std::move(job), counter} );
+        }
+        m_queuedJobs.fetch_add(1, std::memory_order_release);
+
+        if( !m_workers.empty() )
+        {
+            // lock so that a worker which is about to sleep
+            // does not miss the notification
+            std::lock_guard<std::mutex> L(m_sleepMutex);
+            m_sleepCondition.notify_one();
+        }
+    }
+
+    /**
+     * @brief wait
+     * @param counter
+     *
+     * Executes queued jobs until all the jobs submitted with
+     * counter have finished, then rethrows the first exception
+     * thrown by one of them.
+     *
+     * External threads do not execute jobs, they only block until
+     * the job system's threads have finished them. If there are no
+     * worker threads, only the thread which called start() can wait.
+     */
+    void wait(JobCounter & counter)
+    {
+        auto index = workerIndex();
+        if( index == externalThread && m_workers.empty() && !counter.done() )
+        {
+            throw std::runtime_error("The job system has no worker threads, only the thread which started it can wait for jobs");
+        }
+        while( !counter.done() )
+        {
+            if( index == externalThread || !_runOne(index) )
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        std::exception_ptr e;
+        {
+            std::lock_guard<std::mutex> L(counter.exceptionMutex);
+            std::swap(e, counter.exception);
+        }
+        if( !e )
+        {
+            std::lock_guard<std::mutex> L(m_exceptionMutex);
+            std::swap(e, m_exception);
+        }
+        if( e )
+        {
+            std::rethrow_exception(e);
+        }
+    }
+
+    /**
+     * @brief parallelFor
+     * @param begin
+     * @param end
+     * @param grainSize - the number of indices processed by a single job.
+     * @param f - void(uint32_t index)
+     *
+     * Calls f for every index in [begin, end) and returns once
+     * all of them have been processed. The calling thread
+     * processes indices as well.
+     */
+    template<typename callable_t>
+    void parallelFor(uint32_t begin, uint32_t end, uint32_t grainSize, callable_t && f)
+    {
+        if( begin >= end )
+            return;
+
+        grainSize = grainSize == 0 ? 1 : grainSize;
+
+        if( m_workers.empty() || end - begin <= grainSize )
+        {
+            for(uint32_t i=begin; i < end; i++)
+                f(i);
+            return;
+        }
+
+        JobCounter counter;
+        for(uint32_t first=begin; first < end; )
+        {
+            uint32_t last = first + std::min(grainSize, end - first);
+            submit([&f, first, last]()
+            {
+                for(uint32_t i=first; i < last; i++)
+                    f(i);
+            }, &counter);
+            first = last;
+        }
+        wait(counter);
+    }
+
+protected:
+    struct Job
+    {
+        job_function function;
+        JobCounter * counter = nullptr;
+    };
+
+    // kept on separate cache lines so that threads
+    // working on their own queue do not contend
+    struct alignas(64) Queue
+    {
+        std::mutex      mutex;
+        std::deque<Job> jobs;
+    };
+
+    // identifies the job system a worker thread belongs to,
+    // so that the index is not shared between instances
+    struct Worker
+    {
+        JobSystem const * system = nullptr;
+        uint32_t          index  = 0;
+    };
+
+    static Worker & _worker()
+    {
+        static thread_local Worker w;
+        return w;
+    }
+
+    bool _pop(uint32_t index, Job & job)
+    {
+        auto & q = *m_queues[index];
+        std::lock_guard<std::mutex> L(q.mutex);
+        if( q.jobs.empty() )
+            return false;
+        job = std::move(q.jobs.back());
+        q.jobs.pop_back();
+        return true;
+    }
+
+    bool _steal(uint32_t index, Job & job)
+    {
+        auto & q = *m_queues[index];
+        std::unique_lock<std::mutex> L(q.mutex, std::try_to_lock);
+        if( !L.owns_lock() || q.jobs.empty() )
+            return false;
+        job = std::move(q.jobs.front());
+        q.jobs.pop_front();
+        return true;
+    }
+
+    /**
+     * @brief _runOne
+     * @param index
+     * @return
+     *
+     * Executes a job from the thread's own queue, or steals
+     * one from another thread. Returns false if no job was found.
+     */
+    bool _runOne(uint32_t index)
+    {
+        Job job;
+        bool found = _pop(index, job);
+
+        auto n = static_cast<uint32_t>(m_queues.size());
+        for(uint32_t i=1; !found && i < n; i++)
+        {
+            found = _steal( (index + i) % n, job);
+        }
+        if( !found )
+            return false;
+
+        m_queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+        try
+        {
+            job.function();
+        }
+        catch(...)
+        {
+            // keep the first exception, it is rethrown by wait()
+            auto & mutex     = job.counter ? job.counter->exceptionMutex : m_exceptionMutex;
+            auto & exception = job.counter ? job.counter->exception      : m_exception;
+            std::lock_guard<std::mutex> L(mutex);
+            if( !exception )
+                exception = std::current_exception();
+        }
+        if( job.counter )
+        {
+            job.counter->count.fetch_sub(1, std::memory_order_acq_rel);
+        }
+        return true;
+    }
+
+    void _workerLoop(uint32_t index)
+    {
+        while( true )
+        {
+            if( _runOne(index) )
+                continue;
+
+            std::unique_lock<std::mutex> L(m_sleepMutex);
+            m_sleepCondition.wait(L, [this]()
+            {
+                return m_stop || m_queuedJobs.load(std::memory_order_acquire) > 0;
+            });
+            if( m_stop && m_queuedJobs.load(std::memory_order_acquire) == 0 )
+                return;
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread>            m_workers;
+    std::atomic<int64_t>                m_queuedJobs{0};
+    std::mutex                          m_sleepMutex;
+    std::condition_variable             m_sleepCondition;
+    bool                                m_stop = false;
+    std::thread::id                     m_ownerThread;
+    std::mutex                          m_exceptionMutex;
+    std::exception_ptr                  m_exception; // thrown by a job which was submitted without a counter
+};
+
+/**
+ * @brief The TaskGraph class
+ *
+ * A set of tasks with dependencies between them. When the graph
+ * is run, a task is submitted to the job system as soon as all
+ * the tasks it depends on have finished.
+ *
+ * @code
+ * vkw::TaskGraph g;
+ * auto animate = g.addTask([&](){ ... });
+ * auto cull    = g.addTask([&](){ ... });
+ * auto record  = g.addTask([&](){ ... });
+ * g.addDependency(animate, cull);
+ * g.addDependency(cull, record);
+ * g.run(jobSystem());
+ * @endcode
+ */
+class TaskGraph
+{
+public:
+    using task_id = uint32_t;
+
+    task_id addTask(JobSystem::job_function f)
+    {
+        m_nodes.emplace_back();
+        m_nodes.back().function = std::move(f);
+        return static_cast<task_id>(m_nodes.size() - 1);
+    }
+
+    /**
+     * @brief addDependency
+     *
+     * after will not start until before has finished.
+     */
+    void addDependency(task_id before, task_id after)
+    {
+        if( before >= m_nodes.size() || after >= m_nodes.size() )
+        {
+            throw std::runtime_error("Invalid task id");
+        }
+        m_nodes[before].successors.push_back(after);
+        m_nodes[after].dependencyCount++;
+    }
+
+    void clear()
+    {
+        m_nodes.clear();
+    }
+
+    size_t size() const
+    {
+        return m_nodes.size();
+    }
+
+    /**
+     * @brief run
+     * @param jobs
+     *
+     * Runs all the tasks and returns once they have finished.
+     * The graph can be run again afterwards.
+     */
+    void run(JobSystem & jobs)
+    {
+        if( m_nodes.empty() )
+            return;
+
+        _checkForCycles();
+
+        m_pending.reset( new std::atomic<uint32_t>[m_nodes.size()] );
+        for(size_t i=0; i < m_nodes.size(); i++)
+        {
+            m_pending[i].store(m_nodes[i].dependencyCount, std::memory_order_relaxed);
+        }
+
+        JobCounter counter;
+        for(size_t i=0; i < m_nodes.size(); i++)
+        {
+            if( m_nodes[i].dependencyCount == 0 )
+            {
+                _submit(jobs, static_cast<task_id>(i), counter);
+            }
+        }
+        jobs.wait(counter);
+    }
+
+protected:
+    struct Node
+    {
+        JobSystem::job_function function;
+        std::vector<task_id>    successors;
+        uint32_t                dependencyCount = 0;
+    };
+
+    void _submit(JobSystem & jobs, task_id id, JobCounter & counter)
+    {
+        jobs.submit([this, &jobs, &counter, id]()
+        {
+            auto & n = m_nodes[id];
+            n.function();
+
+            // the successors are submitted before this job's
+            // counter is decremented, so the counter cannot
+            // reach zero while tasks are still left
+            for(auto s : n.successors)
+            {
+                if( m_pending[s].fetch_sub(1, std::memory_order_acq_rel) == 1 )
+                {
+                    _submit(jobs, s, counter);
+                }
+            }
+        }, &counter);
+    }
+
+    void _checkForCycles() const
+    {
+        std::vector<uint32_t> count(m_nodes.size());
+        std::vector<task_id>  ready;
+        for(size_t i=0; i < m_nodes.size(); i++)
+        {
+            count[i] = m_nodes[i].dependencyCount;
+            if( count[i] == 0 )
+                ready.push_back(static_cast<task_id>(i));
+        }
+
+        size_t visited = 0;
+        while( !ready.empty() )
+        {
+            auto i = ready.back();
+            ready.pop_back();
+            ++visited;
+            for(auto s : m_nodes[i].successors)
+            {
+                if( --count[s] == 0 )
+                    ready.push_back(s);
+            }
+        }
+        if( visited != m_nodes.size() )
+        {
+            throw std::runtime_error("The task graph contains a cycle");
+        }
+    }
+
+    std::vector<Node>                         m_nodes;
+    std::unique_ptr<std::atomic<uint32_t>[]>  m_pending;
+};
+
+/**
+ * @brief The PerWorker class
+ *
+ * Holds one T for every thread of a job system, each on its own
+ * cache line. Use local() from inside a job to access the calling
+ * thread's value without any synchronization, eg: scratch memory
+ * or partial results which are combined afterwards.
+ */
+template<typename T>
+class PerWorker
+{
+public:
+    PerWorker() = default;
+    explicit PerWorker(JobSystem const & jobs)
+    {
+        init(jobs);
+    }
+
+    /**
+     * @brief init
+     * @param jobs
+     *
+     * Creates one value for every thread of jobs. The job
+     * system must have been started.
+     */
+    void init(JobSystem const & jobs)
+    {
+        m_jobs = &jobs;
+        m_slots.resize(jobs.getThreadCount());
+    }
+
+    size_t size() const
+    {
+        return m_slots.size();
+    }
+
+    /**
+     * @brief local
+     * @return
+     *
+     * Returns the calling thread's value. Throws if the calling
+     * thread is not part of the job system.
+     */
+    T & local()
+    {
+        if( !m_jobs )
+        {
+            throw std::runtime_error("PerWorker has not been initialized with a job system");
+        }
+        auto index = m_jobs->workerIndex();
+        if( index >= m_slots.size() )
+        {
+            throw std::runtime_error("The calling thread is not part of the job system");
+        }
+        return m_slots[index].value;
+    }
+
+    T & operator[](size_t i)
+    {
+        return m_slots[i].value;
+    }
+    T const & operator[](size_t i) const
+    {
+        return m_slots[i].value;
+    }
+
+    template<typename callable_t>
+    void forEach(callable_t && f)
+    {
+        for(auto & s : m_slots)
+            f(s.value);
+    }
+
+protected:
+    struct alignas(64) Slot
+    {
+        T value = T();
+    };
+    std::vector<Slot> m_slots;
+    JobSystem const * m_jobs = nullptr;
+};
+
+}
+
+#endif
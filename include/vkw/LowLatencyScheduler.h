@@ -0,0 +1,181 @@
+#ifndef VKW_LOW_LATENCY_SCHEDULER_H
+#define VKW_LOW_LATENCY_SCHEDULER_H
+
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+namespace vkw
+{
+
+/**
+ * @brief The LowLatencyScheduler class
+ *
+ * Predicts when the GPU will be ready for the next frame and
+ * how long the CPU needs to record it, so that the start of
+ * the CPU work (polling input, updating and recording) can be
+ * delayed as late as possible without starving the GPU.
+ *
+ * The GPU frame time is estimated from the interval between
+ * consecutive frame slots becoming available while the CPU was
+ * blocked waiting for them. The CPU time is measured from the start
+ * of the frame to its submission. Both use an exponential moving
+ * average.
+ *
+ * Once the scheduler delays the CPU, the CPU no longer blocks on
+ * the frame slot, so an unblocked frame on its own does not mean the
+ * application became CPU bound. It is only treated as CPU bound, and
+ * no delay is added, after several consecutive frames which were
+ * neither delayed nor blocked. Only intervals between two blocked
+ * waits are used to estimate the GPU frame time, since a delayed
+ * frame which did not block says nothing about when the GPU finished.
+ */
+class LowLatencyScheduler
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+    using duration   = std::chrono::duration<double, std::nano>;
+
+    /**
+     * @brief setSafetyMargin
+     *
+     * Extra time reserved on top of the predicted CPU time
+     * to absorb jitter.
+     */
+    void setSafetyMargin(duration d)
+    {
+        m_margin = d;
+    }
+
+    /**
+     * @brief setSmoothing
+     * @param s - weight given to new samples, in the range (0,1]
+     */
+    void setSmoothing(double s)
+    {
+        m_smoothing = std::min(1.0, std::max(0.01, s));
+    }
+
+    /**
+     * @brief slotReady
+     * @param waitStart - when the CPU started waiting for the frame slot
+     * @param now - when the frame slot became available
+     * @param framesInFlight - the number of frames still executing on the GPU
+     *
+     * Call this after the frame slot for the next frame is available.
+     */
+    void slotReady(clock_type::time_point waitStart, clock_type::time_point now, uint64_t framesInFlight)
+    {
+        bool blocked     = (now - waitStart) > m_blockedThreshold;
+        m_framesInFlight = framesInFlight;
+
+        if( blocked )
+        {
+            m_gpuBound        = true;
+            m_unblockedFrames = 0;
+        }
+        else if( m_lastDelay.count() <= 0.0 )
+        {
+            // neither delayed nor blocked
+            if( ++m_unblockedFrames >= m_cpuBoundFrames )
+                m_gpuBound = false;
+        }
+
+        if( blocked && m_hasLastReady )
+        {
+            _update(m_gpuFrameTime, now - m_lastReady);
+        }
+
+        // only a blocked wait tells us when the GPU finished
+        m_lastReady    = now;
+        m_hasLastReady = blocked;
+        m_lastDelay    = duration(0);
+    }
+
+    /**
+     * @brief delayed
+     * @param d
+     *
+     * Call this with the delay which was actually applied
+     * before starting work on the frame.
+     */
+    void delayed(duration d)
+    {
+        m_lastDelay = d;
+    }
+
+    /**
+     * @brief cpuBegin
+     *
+     * Call this when the CPU starts working on the frame.
+     */
+    void cpuBegin(clock_type::time_point now = clock_type::now())
+    {
+        m_cpuStart = now;
+    }
+
+    /**
+     * @brief cpuEnd
+     *
+     * Call this after the frame has been submitted.
+     */
+    void cpuEnd(clock_type::time_point now = clock_type::now())
+    {
+        _update(m_cpuTime, now - m_cpuStart);
+    }
+
+    /**
+     * @brief delay
+     * @return
+     *
+     * Returns how long the CPU should wait before
+     * starting work on the next frame.
+     */
+    duration delay() const
+    {
+        if( !m_gpuBound || m_gpuFrameTime.count() <= 0.0 )
+            return duration(0);
+
+        // the GPU is busy with the frames which are still in flight,
+        // it will be ready for the next frame once they are done.
+        auto gpuReady = m_gpuFrameTime * static_cast<double>(m_framesInFlight);
+        auto d        = gpuReady - m_cpuTime - m_margin;
+        return std::max(duration(0), d);
+    }
+
+    duration predictedGpuFrameTime() const
+    {
+        return m_gpuFrameTime;
+    }
+    duration predictedCpuTime() const
+    {
+        return m_cpuTime;
+    }
+
+protected:
+    void _update(duration & value, duration sample)
+    {
+        if( value.count() <= 0.0 )
+            value = sample;
+        else
+            value += (sample - value) * m_smoothing;
+    }
+
+    duration               m_gpuFrameTime     = duration(0);
+    duration               m_cpuTime          = duration(0);
+    duration               m_margin           = std::chrono::microseconds(500);
+    duration               m_blockedThreshold = std::chrono::microseconds(100);
+    double                 m_smoothing        = 0.1;
+    duration               m_lastDelay        = duration(0);
+    uint64_t               m_framesInFlight   = 0;
+    uint32_t               m_unblockedFrames  = 0;
+    uint32_t               m_cpuBoundFrames   = 8; // unblocked frames without a delay before it counts as CPU bound
+    bool                   m_gpuBound         = false;
+    bool                   m_hasLastReady     = false;
+    clock_type::time_point m_lastReady;
+    clock_type::time_point m_cpuStart;
+};
+
+}
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef VKW_MPSC_QUEUE_H
+#define VKW_MPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <utility>
+
+namespace vkw
+{
+
+/**
+ * @brief The MPSCQueue class
+ *
+ * A fixed size, lock-free, multiple producer/single consumer
+ * queue. Any thread may call push(), only one thread may call pop().
+ *
+ * Every slot has a sequence number which tells the producers and
+ * the consumer whose turn it is to use the slot, so producers only
+ * contend on the position counter.
+ *
+ * Each pushed item is given a position, starting at 0, which
+ * increases in the order the items are popped.
+ */
+template<typename T, size_t Capacity>
+class MPSCQueue
+{
+    static_assert( Capacity >= 2 && (Capacity & (Capacity-1)) == 0, "Capacity must be a power of two");
+
+public:
+    MPSCQueue()
+    {
+        for(size_t i=0; i < Capacity; i++)
+        {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief push
+     * @param value
+     * @param position - set to the position of the item in the queue
+     * @return
+     *
+     * Returns false if the queue is full.
+     */
+    bool push(T && value, uint64_t & position)
+    {
+        auto pos = m_enqueuePos.load(std::memory_order_relaxed);
+        Cell * cell;
+        while( true )
+        {
+            cell = &m_cells[pos & (Capacity-1)];
+            auto seq  = cell->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if( diff == 0 )
+            {
+                if( m_enqueuePos.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed) )
+                    break;
+            }
+            else if( diff < 0 )
+            {
+                return false;
+            }
+            else
+            {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos+1, std::memory_order_release);
+        position = pos;
+        return true;
+    }
+
+    /**
+     * @brief pop
+     * @param value
+     * @param position - set to the position the item was pushed at
+     * @return
+     *
+     * Returns false if the queue is empty, or the next
+     * item is still being written by its producer.
+     */
+    bool pop(T & value, uint64_t & position)
+    {
+        auto pos  = m_dequeuePos;
+        auto & cell = m_cells[pos & (Capacity-1)];
+        auto seq  = cell.sequence.load(std::memory_order_acquire);
+        if( static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos+1) < 0 )
+            return false;
+
+        value = std::move(cell.value);
+        cell.sequence.store(pos + Capacity, std::memory_order_release);
+        m_dequeuePos = pos+1;
+        position     = pos;
+        return true;
+    }
+
+    /**
+     * @brief empty
+     * @return
+     *
+     * Returns true if there is nothing to pop. Only
+     * the consumer may call this.
+     */
+    bool empty() const
+    {
+        auto pos = m_dequeuePos;
+        auto seq = m_cells[pos & (Capacity-1)].sequence.load(std::memory_order_acquire);
+        return static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos+1) < 0;
+    }
+
+protected:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T                   value;
+    };
+
+    alignas(64) std::atomic<size_t> m_enqueuePos{0};
+    alignas(64) size_t              m_dequeuePos = 0;
+    alignas(64) std::array<Cell, Capacity> m_cells;
+};
+
+}
+
+#endif
@@ -0,0 +1,333 @@
+#ifndef VKW_PRESENT_THREAD_H
+#define VKW_PRESENT_THREAD_H
+
+#include "vulkan_include.h"
+#include "SPSCQueue.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace vkw
+{
+
+/**
+ * @brief The PresentThread class
+ *
+ * Calls vkQueuePresentKHR on a separate thread. Some drivers block
+ * inside vkQueuePresentKHR, this lets the render thread start on
+ * the next frame as soon as the frame has been submitted.
+ *
+ * Present requests are passed through a lock-free queue. The results
+ * are reported back through takeResults(), so that an out of date
+ * swapchain can still be rebuilt.
+ *
+ * While the thread is running it is the only thread which uses
+ * the swapchain. Vulkan does not allow vkAcquireNextImageKHR and
+ * vkQueuePresentKHR to be called on the same swapchain at once, so
+ * instead of locking the swapchain, the render thread queues its
+ * acquires with acquire() and they are executed in order with the
+ * presents. The present queue is shared with other threads, so it
+ * is guarded by the mutex given to start(). Submits only wait on a
+ * blocked present if the present queue is also the graphics queue.
+ */
+class PresentThread
+{
+public:
+    struct Request
+    {
+        VkSwapchainKHR swapchain     = VK_NULL_HANDLE;
+        uint32_t       imageIndex    = 0;
+        VkSemaphore    waitSemaphore = VK_NULL_HANDLE;
+        uint64_t       frameNumber   = 0;
+        uint64_t       presentId     = 0; // 0 if VK_KHR_present_id is not used
+    };
+
+    struct AcquireRequest
+    {
+        VkSwapchainKHR swapchain          = VK_NULL_HANDLE;
+        VkSemaphore    signalSemaphore    = VK_NULL_HANDLE;
+        uint64_t       timeout            = UINT64_MAX;
+        uint64_t       presentWaitId      = 0;     // wait for this present to be displayed first, 0 = don't wait
+        uint64_t       presentWaitTimeout = 0;
+        bool           presentWaitCapped  = false; // acquire anyway if the present wait times out
+    };
+
+    struct Results
+    {
+        bool outOfDate  = false;
+        bool suboptimal = false;
+    };
+
+    ~PresentThread()
+    {
+        stop();
+    }
+
+    bool isRunning() const
+    {
+        return m_thread.joinable();
+    }
+
+    /**
+     * @brief start
+     * @param waitForPresent - vkWaitForPresentKHR, or nullptr if present wait is not enabled
+     */
+    void start(VkDevice device, VkQueue presentQueue, std::mutex * queueMutex, PFN_vkWaitForPresentKHR waitForPresent)
+    {
+        if( isRunning() )
+            return;
+
+        m_device         = device;
+        m_queue          = presentQueue;
+        m_queueMutex     = queueMutex;
+        m_waitForPresent = waitForPresent;
+        m_stop       = false;
+        m_thread     = std::thread([this]()
+        {
+            _run();
+        });
+    }
+
+    /**
+     * @brief stop
+     *
+     * Presents all the queued requests and joins the thread.
+     */
+    void stop()
+    {
+        if( !isRunning() )
+            return;
+        {
+            std::lock_guard<std::mutex> L(m_mutex);
+            m_stop = true;
+        }
+        m_condition.notify_one();
+        m_thread.join();
+    }
+
+    /**
+     * @brief push
+     * @param r
+     *
+     * Queues a present. Blocks only if the queue is full.
+     */
+    void push(Request const & r)
+    {
+        while( !m_requests.push(r) )
+        {
+            std::this_thread::yield();
+        }
+        m_pushed.fetch_add(1, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> L(m_mutex);
+        }
+        m_condition.notify_one();
+    }
+
+    /**
+     * @brief acquire
+     * @param r
+     * @param imageIndex
+     * @return the result of vkAcquireNextImageKHR
+     *
+     * Acquires the next swapchain image on the present thread, after
+     * all the queued presents have been issued, and blocks until it
+     * has been acquired. If r.presentWaitId is set, the thread first
+     * waits for that present to be displayed. If that wait times out
+     * and r.presentWaitCapped is false, VK_TIMEOUT is returned without
+     * acquiring an image.
+     *
+     * Only one acquire can be in progress at a time.
+     */
+    VkResult acquire(AcquireRequest const & r, uint32_t & imageIndex)
+    {
+        std::unique_lock<std::mutex> L(m_mutex);
+        m_acquireRequest = r;
+        m_acquirePending = true;
+        m_acquireDone    = false;
+        m_condition.notify_one();
+        m_idleCondition.wait(L, [this]()
+        {
+            return m_acquireDone;
+        });
+        imageIndex = m_acquireImageIndex;
+        return m_acquireResult;
+    }
+
+    /**
+     * @brief waitIdle
+     *
+     * Blocks until vkQueuePresentKHR has been called
+     * for all the queued requests.
+     */
+    void waitIdle()
+    {
+        auto target = m_pushed.load(std::memory_order_acquire);
+        std::unique_lock<std::mutex> L(m_mutex);
+        m_idleCondition.wait(L, [&]()
+        {
+            return m_presented.load(std::memory_order_acquire) >= target;
+        });
+    }
+
+    /**
+     * @brief waitUntilPresented
+     * @param frameNumber
+     *
+     * Blocks until the present for frameNumber, and all
+     * the ones before it, have been issued. Returns right away
+     * if there are no queued presents left, eg: frameNumber was
+     * never presented.
+     */
+    void waitUntilPresented(uint64_t frameNumber)
+    {
+        std::unique_lock<std::mutex> L(m_mutex);
+        m_idleCondition.wait(L, [&]()
+        {
+            return m_lastPresentedFrame.load(std::memory_order_acquire) >= frameNumber ||
+                   m_presented.load(std::memory_order_acquire) == m_pushed.load(std::memory_order_acquire);
+        });
+    }
+
+    /**
+     * @brief takeResults
+     * @return
+     *
+     * Returns the results of the presents made since
+     * the last call and clears them.
+     */
+    Results takeResults()
+    {
+        Results r;
+        r.outOfDate  = m_outOfDate.exchange(false, std::memory_order_acq_rel);
+        r.suboptimal = m_suboptimal.exchange(false, std::memory_order_acq_rel);
+        return r;
+    }
+
+protected:
+    void _run()
+    {
+        while( true )
+        {
+            Request r;
+            if( m_requests.pop(r) )
+            {
+                _present(r);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> L(m_mutex);
+            m_condition.wait(L, [this]()
+            {
+                return m_stop || m_acquirePending || !m_requests.empty();
+            });
+
+            // the presents queued before the acquire must
+            // be issued first
+            if( m_acquirePending && m_requests.empty() )
+            {
+                m_acquirePending = false;
+                auto a = m_acquireRequest;
+                L.unlock();
+
+                uint32_t imageIndex = 0;
+                auto result = _acquire(a, imageIndex);
+
+                L.lock();
+                m_acquireImageIndex = imageIndex;
+                m_acquireResult     = result;
+                m_acquireDone       = true;
+                L.unlock();
+                m_idleCondition.notify_all();
+                continue;
+            }
+            if( m_stop && m_requests.empty() )
+                return;
+        }
+    }
+
+    void _present(Request const & r)
+    {
+        VkPresentInfoKHR presentInfo = {};
+        presentInfo.sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        presentInfo.waitSemaphoreCount = 1;
+        presentInfo.pWaitSemaphores    = &r.waitSemaphore;
+        presentInfo.swapchainCount     = 1;
+        presentInfo.pSwapchains        = &r.swapchain;
+        presentInfo.pImageIndices      = &r.imageIndex;
+
+        VkPresentIdKHR presentId = {};
+        if( r.presentId != 0 )
+        {
+            presentId.sType          = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+            presentId.swapchainCount = 1;
+            presentId.pPresentIds    = &r.presentId;
+            presentInfo.pNext        = &presentId;
+        }
+
+        VkResult result;
+        {
+            std::lock_guard<std::mutex> Q(*m_queueMutex);
+            result = vkQueuePresentKHR(m_queue, &presentInfo);
+        }
+
+        if( result == VK_ERROR_OUT_OF_DATE_KHR )
+        {
+            m_outOfDate = true;
+        }
+        if( result == VK_SUBOPTIMAL_KHR )
+        {
+            m_suboptimal = true;
+        }
+
+        m_lastPresentedFrame.store(r.frameNumber, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> L(m_mutex);
+            m_presented.fetch_add(1, std::memory_order_release);
+        }
+        m_idleCondition.notify_all();
+    }
+
+    VkResult _acquire(AcquireRequest const & a, uint32_t & imageIndex)
+    {
+        if( a.presentWaitId != 0 && m_waitForPresent != nullptr )
+        {
+            auto result = m_waitForPresent(m_device, a.swapchain, a.presentWaitId, a.presentWaitTimeout);
+            if( result == VK_TIMEOUT && !a.presentWaitCapped )
+                return VK_TIMEOUT;
+            if( result == VK_ERROR_OUT_OF_DATE_KHR )
+                return result;
+        }
+        return vkAcquireNextImageKHR(m_device, a.swapchain, a.timeout, a.signalSemaphore, VK_NULL_HANDLE, &imageIndex);
+    }
+
+    SPSCQueue<Request, 16>  m_requests;
+    std::thread             m_thread;
+    std::mutex              m_mutex;
+    std::condition_variable m_condition;
+    std::condition_variable m_idleCondition;
+    bool                    m_stop = false;
+
+    VkDevice                m_device         = VK_NULL_HANDLE;
+    VkQueue                 m_queue          = VK_NULL_HANDLE;
+    std::mutex             *m_queueMutex     = nullptr;
+    PFN_vkWaitForPresentKHR m_waitForPresent = nullptr;
+
+    // the acquire in progress, guarded by m_mutex
+    AcquireRequest          m_acquireRequest;
+    bool                    m_acquirePending    = false;
+    bool                    m_acquireDone       = false;
+    uint32_t                m_acquireImageIndex = 0;
+    VkResult                m_acquireResult     = VK_SUCCESS;
+
+    std::atomic<uint64_t>   m_pushed{0};
+    std::atomic<uint64_t>   m_presented{0};
+    std::atomic<uint64_t>   m_lastPresentedFrame{0};
+    std::atomic<bool>       m_outOfDate{false};
+    std::atomic<bool>       m_suboptimal{false};
+};
+
+}
+
+#endif
@@ -10,6 +10,7 @@
 #include <QTimer>
 
 #include <iostream>
+#include <algorithm>
 
 #include "VulkanApplication.h"
 #include "base_widget.h"
@@ -89,10 +90,31 @@ class QTRenderer : public QVulkanWindowRenderer
 
         _frame.clearDepth.depth = 1.0f;
         _frame.clearDepth.stencil = 0;
+
+        // Qt has waited for this frame's fence, the
+        // per-thread pools can be reset
+        auto & threadPools = m_threadCommandPools[static_cast<size_t>(m_window->currentFrame())];
+        for(auto & t : threadPools)
+        {
+            t.reset();
+        }
+        _frame.threadCommandPools     = threadPools.data();
+        _frame.threadCommandPoolCount = static_cast<uint32_t>(threadPools.size());
+        // Qt does not expose frame numbers, count them here. Qt has
+        // waited for the frame which last used this frame slot, frames
+        // complete in order, so it and all the ones before it are done.
+        auto concurrentFrames = static_cast<uint64_t>(m_window->concurrentFrameCount());
+        _frame.frameNumber    = ++m_frameNumber;
+        m_application->m_currentFrameNumber   = m_frameNumber;
+        m_application->m_completedFrameNumber = m_frameNumber > concurrentFrames ? m_frameNumber - concurrentFrames : 0;
+        m_application->m_secondaryCommandCache.collect(m_application->m_completedFrameNumber);
+        m_application->m_coroutines.resume(m_application->m_completedFrameNumber);
+
         m_application->m_renderNextFrame = false;
         m_application->render(_frame);
 
         m_window->frameReady();
+        m_application->m_coroutines.rethrowException();
 
         if( m_application->shouldRender())
         {
@@ -113,6 +135,25 @@ class QTRenderer : public QVulkanWindowRenderer
         //m_application->m_presentQueue       = m_window->presentQ();
         //m_application->m_presentQueueIndex  = getPresentQueueIndex();
 
+        m_application->m_secondaryCommandCache.init(m_application->m_device, m_window->graphicsQueueFamilyIndex());
+        m_application->m_coroutines.init(m_application->m_device);
+
+        // one command pool per job thread for each frame, so that
+        // jobs can record using their workerIndex()
+        auto threadCount = std::max(1u, m_commandThreadCount);
+        m_threadCommandPools.resize( static_cast<size_t>(m_window->concurrentFrameCount()) );
+        for(auto & pools : m_threadCommandPools)
+        {
+            pools.resize(threadCount);
+            for(auto & t : pools)
+            {
+                t.create(m_application->m_device, m_window->graphicsQueueFamilyIndex());
+            }
+        }
+
+        m_jobSystem.start(threadCount);
+        m_application->m_jobSystem = &m_jobSystem;
+
         m_application->initResources();
 
     }
@@ -134,7 +175,13 @@ class QTRenderer : public QVulkanWindowRenderer
             m_application->m_swapchainImages.push_back( m_window->swapChainImage(i));
             m_application->m_swapchainImageViews.push_back( m_window->swapChainImageView(i));
         }
+        // Qt waits for the device to be idle before the
+        // swapchain resources are recreated
+        m_application->m_secondaryCommandCache.invalidateAll();
+        m_application->m_secondaryCommandCache.collect(UINT64_MAX);
+
         m_application->initSwapChainResources();
+        m_application->m_coroutines.notifySwapchainRebuilt();
     }
 
     void releaseSwapChainResources() override
@@ -144,6 +191,17 @@ class QTRenderer : public QVulkanWindowRenderer
 
     void releaseResources() override
     {
+        m_jobSystem.stop();
+        for(auto & pools : m_threadCommandPools)
+        {
+            for(auto & t : pools)
+            {
+                t.destroy();
+            }
+        }
+        m_threadCommandPools.clear();
+        m_application->m_secondaryCommandCache.destroy();
+        m_application->m_coroutines.destroy();
         m_application->releaseResources();
     }
 
@@ -151,6 +209,10 @@ class QTRenderer : public QVulkanWindowRenderer
 protected:
     QVulkanWindow               *m_window;
     vkw::Application            *m_application = nullptr;
+    vkw::JobSystem               m_jobSystem;
+    std::vector<std::vector<FrameCommandPool>> m_threadCommandPools; // [frame][thread]
+    uint64_t                     m_frameNumber = 0;
+    uint32_t                     m_commandThreadCount = 0;
     bool                         m_SystemCreated=false;
     friend class QtVulkanWidget;
 };
@@ -191,6 +253,7 @@ public:
         auto * t = new QTRenderer(this, true);
         assert(m_application != nullptr);
         t->m_application = m_application;
+        t->m_commandThreadCount = m_commandThreadCount;
         return t;
     }
     //=========================================================
@@ -199,8 +262,28 @@ public:
     {
         return m_application;
     }
+
+    /**
+     * @brief setCommandThreadCount
+     * @param count
+     *
+     * The number of threads in the job system and the number of
+     * per-thread command pools in each frame, the same as
+     * SurfaceInitilizationInfo2::commandThreadCount for the other
+     * widgets. At least 1 is used. Must be set before the window
+     * is shown.
+     */
+    void setCommandThreadCount(uint32_t count)
+    {
+        m_commandThreadCount = count;
+    }
+    uint32_t getCommandThreadCount() const
+    {
+        return std::max(1u, m_commandThreadCount);
+    }
 protected:
     Application * m_application = nullptr;
+    uint32_t      m_commandThreadCount = 0;
 
 
 };
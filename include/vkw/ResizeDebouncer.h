@@ -0,0 +1,111 @@
+#ifndef VKW_RESIZE_DEBOUNCER_H
+#define VKW_RESIZE_DEBOUNCER_H
+
+#include <chrono>
+
+namespace vkw
+{
+
+/**
+ * @brief The ResizeDebouncer class
+ *
+ * Decides when the swapchain should be rebuilt while the
+ * window is being resized. Dragging the edge of a window can
+ * produce dozens of resize events per second, rebuilding
+ * the swapchain (and the application's swapchain resources)
+ * for every one of them is wasteful.
+ *
+ * Instead, the old swapchain keeps being presented (the presentation
+ * engine clips or scales it) until no resize event has been received
+ * for stableInterval. If the window keeps changing size, a rebuild
+ * is forced once maxLatency has passed since the first resize event.
+ *
+ * Setting the stableInterval to zero rebuilds on every resize.
+ */
+class ResizeDebouncer
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+    using duration   = std::chrono::nanoseconds;
+
+    void setStableInterval(duration d)
+    {
+        m_stableInterval = d;
+    }
+    duration getStableInterval() const
+    {
+        return m_stableInterval;
+    }
+    void setMaxLatency(duration d)
+    {
+        m_maxLatency = d;
+    }
+    duration getMaxLatency() const
+    {
+        return m_maxLatency;
+    }
+
+    /**
+     * @brief notifyResize
+     *
+     * Call this whenever a resize event is received.
+     */
+    void notifyResize(clock_type::time_point now = clock_type::now())
+    {
+        if( !m_pending )
+        {
+            m_firstResize = now;
+            m_pending = true;
+        }
+        m_lastResize = now;
+    }
+
+    /**
+     * @brief isPending
+     * @return
+     *
+     * Returns true if a resize event has been received
+     * but the swapchain has not been rebuilt yet.
+     */
+    bool isPending() const
+    {
+        return m_pending;
+    }
+
+    /**
+     * @brief shouldRebuild
+     * @return
+     *
+     * Returns true if the window size has been stable long
+     * enough, or the maximum latency has been reached.
+     */
+    bool shouldRebuild(clock_type::time_point now = clock_type::now()) const
+    {
+        if( !m_pending )
+            return false;
+
+        return now - m_lastResize  >= m_stableInterval ||
+               now - m_firstResize >= m_maxLatency;
+    }
+
+    /**
+     * @brief reset
+     *
+     * Call this after the swapchain has been rebuilt.
+     */
+    void reset()
+    {
+        m_pending = false;
+    }
+
+protected:
+    duration               m_stableInterval = std::chrono::milliseconds(50);
+    duration               m_maxLatency     = std::chrono::milliseconds(250);
+    clock_type::time_point m_firstResize;
+    clock_type::time_point m_lastResize;
+    bool                   m_pending = false;
+};
+
+}
+
+#endif
@@ -1,12 +1,12 @@
 #ifndef VKW_SDL_VULKAN_WIDGET3_H
 #define VKW_SDL_VULKAN_WIDGET3_H
 
-#include "VKWVulkanWindow.h"
+#include "VulkanWidgetBase.h"
 #include "Adapters/SDLVulkanWindowAdapter.h"
-#include "VulkanApplication.h"
-#include "Frame.h"
+#include "SPSCQueue.h"
 #include <iostream>
-#include <thread>
+#include <deque>
+#include <chrono>
 
 namespace vkw {
 
@@ -19,8 +19,9 @@ namespace vkw {
  * so that they can be used interchangeably without
  * much modification.
  */
-class SDLVulkanWidget : public VKWVulkanWindow
+class SDLVulkanWidget : public VulkanWidgetBase<SDLVulkanWidget>
 {
+    friend class VulkanWidgetBase<SDLVulkanWidget>;
 public:
     struct CreateInfo
     {
@@ -68,39 +69,31 @@ public:
     template<typename callable_t>
     void  poll( Application * app, callable_t && c)
     {
-        SDL_Event event;
-        while (SDL_PollEvent(&event))
-        {
-            c(event);
-            app->nativeWindowEvent(&event);
-        }
-    }
-
-    void render( Application * app)
-    {
-        auto fr = acquireNextFrame();
-
-        fr.beginCommandBuffer();
-
-        app->m_renderNextFrame = false;
-        app->render(fr);
-
-        fr.endCommandBuffer();
-        frameReady(fr);
+        poll(app, c, std::chrono::milliseconds(0));
     }
 
-    void _initSwapchainVars(Application * app)
+    /**
+     * @brief poll
+     *
+     * Same as above, but blocks for up to timeout
+     * waiting for the first event.
+     */
+    template<typename callable_t>
+    void  poll( Application * app, callable_t && c, std::chrono::milliseconds timeout)
     {
-        app->m_swapChainSize       = getSwapchainExtent();
-        app->m_swapChainFormat     = getSwapchainFormat();
-        app->m_swapChainDepthFormat= getDepthFormat();
-        app->m_concurrentFrameCount= static_cast<uint32_t>(m_swapchainFrameBuffers.size());
-        app->m_defaultRenderPass   = m_renderPass;
-
-        app->m_swapchainImageViews = m_swapchainImageViews;
-        app->m_swapchainImages = m_swapchainImages;
-
-        app->m_currentSwapchainIndex=0;
+        SDL_Event event;
+        bool hasEvent = timeout.count() > 0 ? SDL_WaitEventTimeout(&event, static_cast<int>(timeout.count())) != 0
+                                            : SDL_PollEvent(&event) != 0;
+        while( hasEvent )
+        {
+            // the wake up events are only used to unblock SDL_WaitEventTimeout
+            if( event.type != m_wakeEventType )
+            {
+                c(event);
+                app->nativeWindowEvent(&event);
+            }
+            hasEvent = SDL_PollEvent(&event) != 0;
+        }
     }
 
     template<typename SDL_EVENT_CALLABLE>
@@ -115,75 +108,152 @@ public:
      *
      * Similar to Qt's app.exec(). this will
      * loop until the the windows is closed
+     *
+     * If threaded rendering is enabled, the events are polled
+     * on the calling thread and callable, mainLoop and the
+     * Application are called from the render thread.
      */
     template<typename SDL_EVENT_CALLABLE, typename SDL_MAIN_LOOP_CALLABLE>
     int exec(Application * app, SDL_EVENT_CALLABLE && callable, SDL_MAIN_LOOP_CALLABLE && mainLoop)
     {
-        app->m_device         = getDevice();
-        app->m_physicalDevice = getPhysicalDevice();
-        app->m_instance       = getInstance();
-
-        app->m_graphicsQueue  = getGraphicsQueue();
-        app->m_presentQueue   = getPresentQueue();
-        app->m_graphicsQueueIndex = getGraphicsQueueIndex();
-        app->m_presentQueueIndex  = getPresentQueueIndex();
-
-        _initSwapchainVars(app);
+        if( m_wakeEventType == 0 )
+        {
+            m_wakeEventType = SDL_RegisterEvents(1);
+        }
 
-        app->initResources();
-        app->initSwapChainResources();
+        if( isThreadedRendering() )
+        {
+            return _execThreaded(app, callable, mainLoop);
+        }
 
-        while( true )
+        auto pollEvents = [this, &callable](Application * a, std::chrono::milliseconds timeout, bool & resize)
         {
-            bool resize=false;
-            poll(app, [&resize,&callable](SDL_Event const &E)
+            poll(a, [this,&resize,&callable](SDL_Event const &E)
             {
-                if (E.type == SDL_WINDOWEVENT && E.window.event == SDL_WINDOWEVENT_RESIZED
-                        /*&& event.window.windowID == SDL_GetWindowID( window->getSDLWindow()) */ )
+                if( _isResizeEvent(E) )
                 {
                     resize=true;
                 }
+                _trackWindowState(E);
                 callable(E);
-            });
+            }, timeout);
+            return true;
+        };
+        return _exec(app, pollEvents, mainLoop);
+    }
 
-            if( app->shouldQuit() )
-            {
-                break;
-            }
-            if(resize)
-            {
-                app->releaseSwapChainResources();
-                rebuildSwapchain();
+protected:
+    static bool _isResizeEvent(SDL_Event const & E)
+    {
+        return E.type == SDL_WINDOWEVENT && E.window.event == SDL_WINDOWEVENT_RESIZED;
+                /*&& event.window.windowID == SDL_GetWindowID( window->getSDLWindow()) */
+    }
 
-                _initSwapchainVars(app);
-                app->initSwapChainResources();
-            }
+    void _trackWindowState(SDL_Event const & E)
+    {
+        if( E.type != SDL_WINDOWEVENT )
+            return;
 
-            mainLoop();
-            if( app->shouldRender() )
-            {
-                render(app);
-            }
+        switch( E.window.event )
+        {
+            case SDL_WINDOWEVENT_MINIMIZED:
+            case SDL_WINDOWEVENT_HIDDEN:
+                _setWindowMinimized(true);
+                break;
+            case SDL_WINDOWEVENT_RESTORED:
+            case SDL_WINDOWEVENT_MAXIMIZED:
+            case SDL_WINDOWEVENT_SHOWN:
+                _setWindowMinimized(false);
+                break;
+            case SDL_WINDOWEVENT_FOCUS_GAINED:
+                m_windowFocused = true;
+                break;
+            case SDL_WINDOWEVENT_FOCUS_LOST:
+                m_windowFocused = false;
+                break;
+            default:
+                break;
         }
+    }
 
-        app->releaseSwapChainResources();
-        app->releaseResources();
-        destroy();
-
-        return 0;
+    /**
+     * @brief _postWakeEvent
+     *
+     * Unblocks SDL_WaitEventTimeout, called from any thread.
+     */
+    void _postWakeEvent()
+    {
+        if( m_wakeEventType != 0 && m_wakeEventType != static_cast<Uint32>(-1) )
+        {
+            SDL_Event E = {};
+            E.type = m_wakeEventType;
+            SDL_PushEvent(&E);
+        }
     }
 
     /**
-     * @brief frameReady
+     * @brief _execThreaded
      *
-     * Call this function to present the frame.
+     * The calling thread only pumps the SDL events and pushes them
+     * to the render thread through a lock-free queue.
      */
-    void frameReady(Frame & fr)
+    template<typename SDL_EVENT_CALLABLE, typename SDL_MAIN_LOOP_CALLABLE>
+    int _execThreaded(Application * app, SDL_EVENT_CALLABLE && callable, SDL_MAIN_LOOP_CALLABLE && mainLoop)
     {
-        submitFrame(fr);
-        presentFrame(fr);
-        waitForPresent();
+        auto drain = [this, &callable](Application * a, bool & resize)
+        {
+            SDL_Event E;
+            while( m_eventQueue.pop(E) )
+            {
+                if( _isResizeEvent(E) )
+                {
+                    resize=true;
+                }
+                _trackWindowState(E);
+                callable(E);
+                a->nativeWindowEvent(&E);
+            }
+            return true;
+        };
+
+        // events which did not fit in the queue are kept
+        // here, in order, until the render thread catches up.
+        std::deque<SDL_Event> pending;
+        auto pump = [this, &pending]()
+        {
+            SDL_Event E;
+            if( SDL_WaitEventTimeout(&E, 5) )
+            {
+                pending.push_back(E);
+                while( SDL_PollEvent(&E) )
+                {
+                    pending.push_back(E);
+                }
+            }
+            bool forwarded = false;
+            while( !pending.empty() )
+            {
+                if( _isResizeEvent(pending.front()) )
+                {
+                    // update the size before the render thread sees the event
+                    _cacheDrawableSize();
+                }
+                if( !m_eventQueue.push(pending.front()) )
+                    break;
+                pending.pop_front();
+                forwarded = true;
+            }
+            if( forwarded )
+            {
+                _notifyRenderThread();
+            }
+        };
+
+        return VulkanWidgetBase<SDLVulkanWidget>::_execThreaded(app, drain, pump, mainLoop);
     }
+
+    SPSCQueue<SDL_Event, 1024> m_eventQueue;
+    Uint32                     m_wakeEventType = 0;
 };
 
 }
@@ -0,0 +1,79 @@
+#ifndef VKW_SPSC_QUEUE_H
+#define VKW_SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <array>
+
+namespace vkw
+{
+
+/**
+ * @brief The SPSCQueue class
+ *
+ * A fixed size, lock-free, single producer/single consumer
+ * ring buffer. Only one thread may call push() and only one
+ * (other) thread may call pop().
+ *
+ * Capacity must be a power of two. One slot is always left
+ * empty, so at most Capacity-1 items can be queued.
+ */
+template<typename T, size_t Capacity>
+class SPSCQueue
+{
+    static_assert( Capacity >= 2 && (Capacity & (Capacity-1)) == 0, "Capacity must be a power of two");
+
+public:
+    /**
+     * @brief push
+     * @param value
+     * @return
+     *
+     * Returns false if the queue is full.
+     */
+    bool push(T const & value)
+    {
+        auto head = m_head.load(std::memory_order_relaxed);
+        auto next = (head + 1) & (Capacity-1);
+        if( next == m_tail.load(std::memory_order_acquire) )
+            return false;
+
+        m_items[head] = value;
+        m_head.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief pop
+     * @param value
+     * @return
+     *
+     * Returns false if the queue is empty.
+     */
+    bool pop(T & value)
+    {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        if( tail == m_head.load(std::memory_order_acquire) )
+            return false;
+
+        value = m_items[tail];
+        m_tail.store( (tail + 1) & (Capacity-1), std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return m_tail.load(std::memory_order_acquire) == m_head.load(std::memory_order_acquire);
+    }
+
+protected:
+    // the producer and consumer indices are kept on separate
+    // cache lines so the two threads do not contend
+    alignas(64) std::atomic<size_t> m_head{0};
+    alignas(64) std::atomic<size_t> m_tail{0};
+    alignas(64) std::array<T, Capacity> m_items;
+};
+
+}
+
+#endif
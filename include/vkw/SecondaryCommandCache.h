@@ -0,0 +1,240 @@
+#ifndef VKW_SECONDARY_COMMAND_CACHE_H
+#define VKW_SECONDARY_COMMAND_CACHE_H
+
+#include "vulkan_include.h"
+#include "Frame.h"
+#include <vector>
+#include <unordered_map>
+#include <stdexcept>
+
+namespace vkw
+{
+
+/**
+ * @brief The SecondaryCommandCache class
+ *
+ * A cache of pre-recorded secondary command buffers which are
+ * compatible with the default render pass. Each entry is identified
+ * by an id chosen by the application and is only recorded the first
+ * time it is requested, or after it has been invalidated.
+ *
+ * The buffers are recorded with VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT
+ * so that the same buffer can be executed by all the frames in flight.
+ *
+ * The widgets invalidate the whole cache before initSwapChainResources()
+ * is called, since the render pass or the extent may have changed.
+ * Invalidated buffers are kept until the last frame which used
+ * them has completed and are then reused.
+ *
+ * The cache is not thread safe. Only use it from the thread which
+ * records the frame's primary command buffer, ie: from render(),
+ * not from jobs recording into the per-thread command pools.
+ *
+ * @code
+ * void render(vkw::Frame & frame) override
+ * {
+ *     frame.beginRenderPass(frame.commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+ *
+ *     secondaryCommandCache().execute(frame.commandBuffer, UI_ID, frame, [&](VkCommandBuffer cmd)
+ *     {
+ *         // record the static content
+ *     });
+ *
+ *     frame.endRenderPass(frame.commandBuffer);
+ * }
+ * @endcode
+ */
+class SecondaryCommandCache
+{
+public:
+    ~SecondaryCommandCache()
+    {
+        destroy();
+    }
+
+    void init(VkDevice device, uint32_t queueFamilyIndex)
+    {
+        if( m_commandPool != VK_NULL_HANDLE )
+            return;
+
+        m_device = device;
+
+        VkCommandPoolCreateInfo cmdC = {};
+        cmdC.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        cmdC.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        cmdC.queueFamilyIndex = queueFamilyIndex;
+
+        if( VkResult::VK_SUCCESS != vkCreateCommandPool(m_device, &cmdC, nullptr, &m_commandPool) )
+        {
+            throw std::runtime_error("Failed to create secondary command cache pool");
+        }
+    }
+
+    /**
+     * @brief destroy
+     *
+     * Frees all the command buffers. None of them
+     * can be in use by the GPU.
+     */
+    void destroy()
+    {
+        if( m_commandPool != VK_NULL_HANDLE )
+        {
+            vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+            m_commandPool = VK_NULL_HANDLE;
+        }
+        m_entries.clear();
+        m_retired.clear();
+        m_free.clear();
+    }
+
+    bool contains(uint64_t id) const
+    {
+        return m_entries.count(id) != 0;
+    }
+
+    /**
+     * @brief get
+     * @param id
+     * @param frame
+     * @param record - void(VkCommandBuffer), records the commands
+     * @return
+     *
+     * Returns the command buffer for id. If it has not been recorded
+     * yet, a command buffer is begun, record is called and the
+     * command buffer is ended.
+     */
+    template<typename callable_t>
+    VkCommandBuffer get(uint64_t id, Frame const & frame, callable_t && record)
+    {
+        auto it = m_entries.find(id);
+        if( it != m_entries.end() )
+        {
+            it->second.lastUsedFrame = frame.frameNumber;
+            return it->second.commandBuffer;
+        }
+
+        Entry e;
+        e.commandBuffer = _allocate();
+        e.lastUsedFrame = frame.frameNumber;
+
+        // the buffer is executed with every swapchain image's
+        // framebuffer, so do not inherit a specific one
+        frame.beginSecondaryCommandBuffer(e.commandBuffer,
+                                          VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
+                                          VK_NULL_HANDLE);
+        record(e.commandBuffer);
+        vkEndCommandBuffer(e.commandBuffer);
+
+        m_entries[id] = e;
+        return e.commandBuffer;
+    }
+
+    /**
+     * @brief execute
+     *
+     * Same as get(), but also executes the command buffer
+     * from the primary command buffer.
+     */
+    template<typename callable_t>
+    void execute(VkCommandBuffer primary, uint64_t id, Frame const & frame, callable_t && record)
+    {
+        auto cmd = get(id, frame, record);
+        vkCmdExecuteCommands(primary, 1, &cmd);
+    }
+
+    /**
+     * @brief invalidate
+     *
+     * Forces the entry to be recorded again the next
+     * time it is requested.
+     */
+    void invalidate(uint64_t id)
+    {
+        auto it = m_entries.find(id);
+        if( it != m_entries.end() )
+        {
+            m_retired.push_back(it->second);
+            m_entries.erase(it);
+        }
+    }
+
+    void invalidateAll()
+    {
+        for(auto & e : m_entries)
+        {
+            m_retired.push_back(e.second);
+        }
+        m_entries.clear();
+    }
+
+    /**
+     * @brief collect
+     * @param completedFrameNumber
+     *
+     * Makes the invalidated command buffers which are no longer
+     * used by the GPU available for reuse.
+     */
+    void collect(uint64_t completedFrameNumber)
+    {
+        for(size_t i=0; i < m_retired.size(); )
+        {
+            if( m_retired[i].lastUsedFrame <= completedFrameNumber )
+            {
+                m_free.push_back(m_retired[i].commandBuffer);
+                m_retired[i] = m_retired.back();
+                m_retired.pop_back();
+            }
+            else
+            {
+                ++i;
+            }
+        }
+    }
+
+protected:
+    struct Entry
+    {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        uint64_t        lastUsedFrame = 0;
+    };
+
+    VkCommandBuffer _allocate()
+    {
+        if( m_commandPool == VK_NULL_HANDLE )
+        {
+            throw std::runtime_error("The secondary command cache has not been initialized");
+        }
+        if( !m_free.empty() )
+        {
+            // the pool was created with RESET_COMMAND_BUFFER_BIT, so
+            // beginning the buffer again implicitly resets it
+            auto cmd = m_free.back();
+            m_free.pop_back();
+            return cmd;
+        }
+
+        VkCommandBufferAllocateInfo allocateInfo = {};
+        allocateInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocateInfo.commandPool        = m_commandPool;
+        allocateInfo.level              = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocateInfo.commandBufferCount = 1;
+
+        VkCommandBuffer cmd = VK_NULL_HANDLE;
+        if( VkResult::VK_SUCCESS != vkAllocateCommandBuffers(m_device, &allocateInfo, &cmd) )
+        {
+            throw std::runtime_error("Failed to allocate secondary command buffer");
+        }
+        return cmd;
+    }
+
+    VkDevice                               m_device      = VK_NULL_HANDLE;
+    VkCommandPool                          m_commandPool = VK_NULL_HANDLE;
+    std::unordered_map<uint64_t, Entry>    m_entries;
+    std::vector<Entry>                     m_retired;
+    std::vector<VkCommandBuffer>           m_free;
+};
+
+}
+
+#endif
@@ -0,0 +1,537 @@
+#ifndef VKW_SUBMISSION_SERVICE_H
+#define VKW_SUBMISSION_SERVICE_H
+
+#include "vulkan_include.h"
+#include "MPSCQueue.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace vkw
+{
+
+/**
+ * @brief The SubmitBatch struct
+ *
+ * A set of command buffers to submit to the graphics queue,
+ * with the semaphores to wait on and to signal.
+ */
+struct SubmitBatch
+{
+    std::vector<VkSemaphoreSubmitInfo>     waitSemaphores;
+    std::vector<VkCommandBufferSubmitInfo> commandBuffers;
+    std::vector<VkSemaphoreSubmitInfo>     signalSemaphores;
+
+    SubmitBatch & addCommandBuffer(VkCommandBuffer cb)
+    {
+        VkCommandBufferSubmitInfo S = {};
+        S.sType         = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+        S.commandBuffer = cb;
+        commandBuffers.push_back(S);
+        return *this;
+    }
+    SubmitBatch & addWaitSemaphore(VkSemaphore semaphore, VkPipelineStageFlags2 stageMask, uint64_t value = 0)
+    {
+        waitSemaphores.push_back( _semaphore(semaphore, stageMask, value) );
+        return *this;
+    }
+    SubmitBatch & addSignalSemaphore(VkSemaphore semaphore, VkPipelineStageFlags2 stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, uint64_t value = 0)
+    {
+        signalSemaphores.push_back( _semaphore(semaphore, stageMask, value) );
+        return *this;
+    }
+
+protected:
+    static VkSemaphoreSubmitInfo _semaphore(VkSemaphore semaphore, VkPipelineStageFlags2 stageMask, uint64_t value)
+    {
+        VkSemaphoreSubmitInfo S = {};
+        S.sType     = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+        S.semaphore = semaphore;
+        S.stageMask = stageMask;
+        S.value     = value;
+        return S;
+    }
+};
+
+/**
+ * @brief The SubmissionService class
+ *
+ * VkQueue access must be externally synchronized. Instead of
+ * locking the queue, any thread can push a SubmitBatch to the
+ * service. The window drains the batches when it submits the next
+ * frame and sends them, together with the frame, in a single
+ * queue submission. Consecutive batches which do not wait on or
+ * signal any semaphores are merged into one VkSubmitInfo2.
+ *
+ * submit() returns a ticket. Since the batches are submitted before
+ * the frame, and a frame's fence/timeline signal covers all the work
+ * submitted before it, the batch has completed once the frame it
+ * was submitted with has completed. isComplete(ticket) checks this.
+ *
+ * If no frame is rendered, eg: while the window is minimized, the
+ * window calls flush() instead, which submits the batches on their
+ * own with a fence.
+ *
+ * The queue holds 256 batches. If it is full, other threads wait
+ * for the owner to drain it, while the owner, the thread which submits
+ * the frames, flushes the queued batches itself.
+ *
+ * @code
+ * auto ticket = submissionService().submit( vkw::SubmitBatch().addCommandBuffer(uploadCmd) );
+ * ...
+ * if( submissionService().isComplete(ticket) )
+ *     // the upload has finished
+ * @endcode
+ */
+class SubmissionService
+{
+public:
+    using ticket_type = uint64_t;
+
+    /**
+     * @brief submit
+     * @param batch
+     * @return
+     *
+     * Queues the batch to be submitted with the next frame.
+     * Can be called from any thread.
+     */
+    ticket_type submit(SubmitBatch batch)
+    {
+        uint64_t position = 0;
+        while( !m_batches.push(std::move(batch), position) )
+        {
+            if( std::this_thread::get_id() == m_ownerThread.load(std::memory_order_relaxed) )
+            {
+                // the owner would be waiting for itself,
+                // submit the queued batches now
+                if( !m_flushFunction )
+                {
+                    throw std::runtime_error("The submission queue is full");
+                }
+                m_flushFunction();
+            }
+            else
+            {
+                // full, wait for the owner to drain it
+                std::this_thread::yield();
+            }
+        }
+        if( m_onSubmit )
+        {
+            m_onSubmit();
+        }
+        return position + 1;
+    }
+
+    /**
+     * @brief isComplete
+     * @param ticket
+     * @return
+     *
+     * Returns true if the GPU has finished executing the batch.
+     */
+    bool isComplete(ticket_type ticket) const
+    {
+        return m_completedTicket.load(std::memory_order_acquire) >= ticket;
+    }
+
+    /**
+     * @brief empty
+     * @return
+     *
+     * Returns true if there are no batches waiting to be submitted.
+     */
+    bool empty() const
+    {
+        return m_batches.empty();
+    }
+
+    /**
+     * @brief setSubmitCallback
+     *
+     * Called after a batch has been queued. The widgets use
+     * this to wake up their event loop, so that the batch is
+     * submitted even if the application is idle.
+     */
+    void setSubmitCallback(std::function<void()> f)
+    {
+        m_onSubmit = std::move(f);
+    }
+
+    /**
+     * @brief init
+     * @param device
+     * @param flushFunction - submits the queued batches, called by
+     *                        submit() on the owner thread if the
+     *                        queue is full
+     *
+     * Called by the window once the device has been created.
+     */
+    void init(VkDevice device, std::function<void()> flushFunction)
+    {
+        m_device        = device;
+        m_flushFunction = std::move(flushFunction);
+    }
+
+    /**
+     * @brief setOwnerThread
+     *
+     * Makes the calling thread the owner, the only thread which
+     * drains the queue. submitFrame() and flush() do this as well.
+     */
+    void setOwnerThread()
+    {
+        m_ownerThread.store(std::this_thread::get_id(), std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief destroy
+     *
+     * Destroys the fences used by flush(). The device
+     * must be idle.
+     */
+    void destroy()
+    {
+        for(auto & p : m_pending)
+        {
+            if( p.fence != VK_NULL_HANDLE )
+                vkDestroyFence(m_device, p.fence, nullptr);
+        }
+        for(auto f : m_freeFences)
+        {
+            vkDestroyFence(m_device, f, nullptr);
+        }
+        m_pending.clear();
+        m_freeFences.clear();
+    }
+
+    /**
+     * @brief submitFrame
+     * @param queue
+     * @param queueMutex
+     * @param queueSubmit2 - null if synchronization2 is not available
+     * @param timelineValues - true if the timeline semaphore feature is enabled
+     * @param frameInfo - the frame's own submission
+     * @param fence
+     * @param frameNumber
+     *
+     * Called by the owner of the queue. Drains the queued batches
+     * and submits them, followed by frameInfo, in one call.
+     */
+    void submitFrame(VkQueue queue,
+                     std::mutex & queueMutex,
+                     PFN_vkQueueSubmit2 queueSubmit2,
+                     bool timelineValues,
+                     VkSubmitInfo2 const & frameInfo,
+                     VkFence fence,
+                     uint64_t frameNumber)
+    {
+        setOwnerThread();
+        auto lastTicket = _drain();
+        m_submitInfos.push_back(frameInfo);
+
+        _submit(queue, queueMutex, queueSubmit2, timelineValues, fence);
+
+        if( lastTicket != 0 )
+        {
+            m_pending.push_back({frameNumber, VK_NULL_HANDLE, lastTicket});
+        }
+    }
+
+    /**
+     * @brief flush
+     *
+     * Called by the owner when no frame is being submitted, eg: while
+     * the window is minimized or frame rate limited. Submits the queued
+     * batches on their own with a fence, so that their tickets
+     * still complete.
+     */
+    void flush(VkQueue queue,
+               std::mutex & queueMutex,
+               PFN_vkQueueSubmit2 queueSubmit2,
+               bool timelineValues)
+    {
+        setOwnerThread();
+        if( m_batches.empty() )
+            return;
+
+        auto lastTicket = _drain();
+        if( lastTicket == 0 )
+            return;
+
+        VkFence fence = VK_NULL_HANDLE;
+        if( !m_freeFences.empty() )
+        {
+            fence = m_freeFences.back();
+            m_freeFences.pop_back();
+        }
+        else
+        {
+            VkFenceCreateInfo fenceInfo = {};
+            fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            if( VK_SUCCESS != vkCreateFence(m_device, &fenceInfo, nullptr, &fence) )
+            {
+                throw std::runtime_error("Failed to create the submission fence");
+            }
+        }
+
+        _submit(queue, queueMutex, queueSubmit2, timelineValues, fence);
+        m_pending.push_back({0, fence, lastTicket});
+    }
+
+    /**
+     * @brief retire
+     * @param completedFrameNumber
+     *
+     * Called by the owner once frames have completed on the GPU.
+     * Submissions complete in order, so the tickets are retired
+     * in the order they were submitted.
+     */
+    void retire(uint64_t completedFrameNumber)
+    {
+        size_t n = 0;
+        for(; n < m_pending.size(); n++)
+        {
+            auto & p = m_pending[n];
+            if( p.fence != VK_NULL_HANDLE )
+            {
+                if( vkGetFenceStatus(m_device, p.fence) != VK_SUCCESS )
+                    break;
+                vkResetFences(m_device, 1, &p.fence);
+                m_freeFences.push_back(p.fence);
+            }
+            else if( p.frameNumber > completedFrameNumber )
+            {
+                break;
+            }
+            m_completedTicket.store(p.lastTicket, std::memory_order_release);
+        }
+        if( n > 0 )
+        {
+            m_pending.erase(m_pending.begin(), m_pending.begin() + static_cast<std::ptrdiff_t>(n));
+        }
+    }
+
+protected:
+    struct Pending
+    {
+        uint64_t frameNumber; // 0 if submitted by flush()
+        VkFence  fence;       // only set if submitted by flush()
+        uint64_t lastTicket;
+    };
+
+    /**
+     * @brief _drain
+     * @return
+     *
+     * Pops the queued batches and builds their submit infos.
+     * Returns the ticket of the last batch, or 0 if there were none.
+     */
+    uint64_t _drain()
+    {
+        m_drained.clear();
+        m_infos.clear();
+        m_submitInfos.clear();
+
+        SubmitBatch b;
+        uint64_t    position = 0;
+        uint64_t    lastTicket = 0;
+        while( m_batches.pop(b, position) )
+        {
+            m_drained.push_back( std::move(b) );
+            lastTicket = position + 1;
+        }
+
+        for(auto & d : m_drained)
+        {
+            bool mergeable = d.waitSemaphores.empty() && d.signalSemaphores.empty();
+            if( mergeable && !m_infos.empty() && m_lastInfoMergeable )
+            {
+                // append the command buffers to the previous batch
+                auto & prev = m_drained[m_infos.back().first];
+                prev.commandBuffers.insert(prev.commandBuffers.end(), d.commandBuffers.begin(), d.commandBuffers.end());
+                d.commandBuffers.clear();
+                continue;
+            }
+            m_infos.push_back({ static_cast<size_t>(&d - m_drained.data()), mergeable});
+            m_lastInfoMergeable = mergeable;
+        }
+
+        for(auto & i : m_infos)
+        {
+            auto & d = m_drained[i.first];
+
+            VkSubmitInfo2 S = {};
+            S.sType                    = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+            S.waitSemaphoreInfoCount   = static_cast<uint32_t>(d.waitSemaphores.size());
+            S.pWaitSemaphoreInfos      = d.waitSemaphores.data();
+            S.commandBufferInfoCount   = static_cast<uint32_t>(d.commandBuffers.size());
+            S.pCommandBufferInfos      = d.commandBuffers.data();
+            S.signalSemaphoreInfoCount = static_cast<uint32_t>(d.signalSemaphores.size());
+            S.pSignalSemaphoreInfos    = d.signalSemaphores.data();
+            m_submitInfos.push_back(S);
+        }
+        return lastTicket;
+    }
+
+    void _submit(VkQueue queue, std::mutex & queueMutex, PFN_vkQueueSubmit2 queueSubmit2, bool timelineValues, VkFence fence)
+    {
+        {
+            std::lock_guard<std::mutex> L(queueMutex);
+            if( queueSubmit2 )
+            {
+                queueSubmit2(queue, static_cast<uint32_t>(m_submitInfos.size()), m_submitInfos.data(), fence);
+            }
+            else
+            {
+                _submitLegacy(queue, timelineValues, fence);
+            }
+        }
+        m_drained.clear();
+    }
+
+    /**
+     * @brief _legacyStageMask
+     * @param stages
+     * @return
+     *
+     * Converts a synchronization2 wait stage mask to a legacy one. The
+     * lower 32 bits are the same, the stages which only exist in
+     * synchronization2 are mapped to the legacy stage which contains them.
+     * A wait on a stage also blocks all the logically later stages, so
+     * anything else is waited on at VK_PIPELINE_STAGE_ALL_COMMANDS_BIT.
+     */
+    static VkPipelineStageFlags _legacyStageMask(VkPipelineStageFlags2 stages)
+    {
+        if( stages == VK_PIPELINE_STAGE_2_NONE )
+            return VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+        const VkPipelineStageFlags2 transfer    = VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_RESOLVE_BIT |
+                                                  VK_PIPELINE_STAGE_2_BLIT_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT;
+        const VkPipelineStageFlags2 vertexInput = VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT | VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT;
+        const VkPipelineStageFlags2 preRaster   = VK_PIPELINE_STAGE_2_PRE_RASTERIZATION_SHADERS_BIT;
+        const VkPipelineStageFlags2 legacyBits  = 0xFFFFFFFFull;
+
+        VkPipelineStageFlags legacy = static_cast<VkPipelineStageFlags>(stages & legacyBits);
+        if( stages & transfer )
+            legacy |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+        if( stages & vertexInput )
+            legacy |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+        if( stages & preRaster )
+            legacy |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+        if( stages & ~(legacyBits | transfer | vertexInput | preRaster) )
+            legacy |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        return legacy;
+    }
+
+    /**
+     * @brief _submitLegacy
+     *
+     * synchronization2 is not available, convert the
+     * submissions to the legacy structures.
+     */
+    void _submitLegacy(VkQueue queue, bool timelineValues, VkFence fence)
+    {
+        size_t waitCount   = 0;
+        size_t signalCount = 0;
+        size_t cmdCount    = 0;
+        for(auto & s : m_submitInfos)
+        {
+            waitCount   += s.waitSemaphoreInfoCount;
+            signalCount += s.signalSemaphoreInfoCount;
+            cmdCount    += s.commandBufferInfoCount;
+        }
+
+        // size everything first so the pointers stay valid
+        m_legacy.waitSemaphores.resize(waitCount);
+        m_legacy.waitStages.resize(waitCount);
+        m_legacy.waitValues.resize(waitCount);
+        m_legacy.signalSemaphores.resize(signalCount);
+        m_legacy.signalValues.resize(signalCount);
+        m_legacy.commandBuffers.resize(cmdCount);
+        m_legacy.timelineInfos.resize(m_submitInfos.size());
+        m_legacy.submitInfos.resize(m_submitInfos.size());
+
+        size_t w=0, sg=0, c=0;
+        for(size_t i=0; i < m_submitInfos.size(); i++)
+        {
+            auto & in = m_submitInfos[i];
+
+            auto w0 = w, s0 = sg, c0 = c;
+            for(uint32_t j=0; j < in.waitSemaphoreInfoCount; j++, w++)
+            {
+                m_legacy.waitSemaphores[w] = in.pWaitSemaphoreInfos[j].semaphore;
+                m_legacy.waitStages[w]     = _legacyStageMask(in.pWaitSemaphoreInfos[j].stageMask);
+                m_legacy.waitValues[w]     = in.pWaitSemaphoreInfos[j].value;
+            }
+            for(uint32_t j=0; j < in.signalSemaphoreInfoCount; j++, sg++)
+            {
+                m_legacy.signalSemaphores[sg] = in.pSignalSemaphoreInfos[j].semaphore;
+                m_legacy.signalValues[sg]     = in.pSignalSemaphoreInfos[j].value;
+            }
+            for(uint32_t j=0; j < in.commandBufferInfoCount; j++, c++)
+            {
+                m_legacy.commandBuffers[c] = in.pCommandBufferInfos[j].commandBuffer;
+            }
+
+            auto & timelineInfo = m_legacy.timelineInfos[i];
+            timelineInfo = {};
+            timelineInfo.sType                     = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            timelineInfo.waitSemaphoreValueCount   = in.waitSemaphoreInfoCount;
+            timelineInfo.pWaitSemaphoreValues      = m_legacy.waitValues.data() + w0;
+            timelineInfo.signalSemaphoreValueCount = in.signalSemaphoreInfoCount;
+            timelineInfo.pSignalSemaphoreValues    = m_legacy.signalValues.data() + s0;
+
+            auto & submitInfo = m_legacy.submitInfos[i];
+            submitInfo = {};
+            submitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            // the timeline values are only valid if the feature is enabled
+            submitInfo.pNext                = timelineValues ? &timelineInfo : nullptr;
+            submitInfo.waitSemaphoreCount   = in.waitSemaphoreInfoCount;
+            submitInfo.pWaitSemaphores      = m_legacy.waitSemaphores.data() + w0;
+            submitInfo.pWaitDstStageMask    = m_legacy.waitStages.data() + w0;
+            submitInfo.commandBufferCount   = in.commandBufferInfoCount;
+            submitInfo.pCommandBuffers      = m_legacy.commandBuffers.data() + c0;
+            submitInfo.signalSemaphoreCount = in.signalSemaphoreInfoCount;
+            submitInfo.pSignalSemaphores    = m_legacy.signalSemaphores.data() + s0;
+        }
+        vkQueueSubmit(queue, static_cast<uint32_t>(m_legacy.submitInfos.size()), m_legacy.submitInfos.data(), fence);
+    }
+
+    MPSCQueue<SubmitBatch, 256>           m_batches;
+    std::atomic<uint64_t>                 m_completedTicket{0};
+    std::function<void()>                 m_onSubmit;
+    std::function<void()>                 m_flushFunction;
+    std::atomic<std::thread::id>          m_ownerThread{std::thread::id()};
+
+    // only used by the owner. Kept between frames
+    // so that no memory is allocated each frame.
+    std::vector<SubmitBatch>              m_drained;
+    std::vector<std::pair<size_t,bool>>   m_infos; // index into m_drained, mergeable
+    bool                                  m_lastInfoMergeable = false;
+    std::vector<VkSubmitInfo2>            m_submitInfos;
+    std::vector<Pending>                  m_pending;
+    std::vector<VkFence>                  m_freeFences;
+    VkDevice                              m_device = VK_NULL_HANDLE;
+
+    struct
+    {
+        std::vector<VkSemaphore>                   waitSemaphores;
+        std::vector<VkPipelineStageFlags>          waitStages;
+        std::vector<uint64_t>                      waitValues;
+        std::vector<VkSemaphore>                   signalSemaphores;
+        std::vector<uint64_t>                      signalValues;
+        std::vector<VkCommandBuffer>               commandBuffers;
+        std::vector<VkTimelineSemaphoreSubmitInfo> timelineInfos;
+        std::vector<VkSubmitInfo>                  submitInfos;
+    } m_legacy;
+};
+
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef VKW_THREAD_AFFINITY_H
+#define VKW_THREAD_AFFINITY_H
+
+#include <thread>
+#include <cstdint>
+
+#if defined(_WIN32)
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#elif defined(__linux__)
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+namespace vkw
+{
+
+/**
+ * @brief setThreadAffinity
+ * @param t
+ * @param cpuIndex
+ * @return
+ *
+ * Pins the thread to a single logical CPU. Returns false
+ * if the affinity could not be set or if it is not supported
+ * on this platform (eg: macOS).
+ */
+inline bool setThreadAffinity(std::thread & t, uint32_t cpuIndex)
+{
+#if defined(_WIN32)
+    if( cpuIndex >= sizeof(DWORD_PTR)*8 )
+        return false;
+    auto mask = static_cast<DWORD_PTR>(1) << cpuIndex;
+    return SetThreadAffinityMask( static_cast<HANDLE>(t.native_handle()), mask) != 0;
+#elif defined(__linux__)
+    if( cpuIndex >= CPU_SETSIZE )
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpuIndex, &set);
+    return pthread_setaffinity_np(t.native_handle(), sizeof(cpu_set_t), &set) == 0;
+#else
+    (void)t;
+    (void)cpuIndex;
+    return false;
+#endif
+}
+
+}
+
+#endif
@@ -4,8 +4,21 @@
 #include "vulkan_include.h"
 
 #include <vector>
+#include <algorithm>
 #include <string>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include "Frame.h"
+#include "ResizeDebouncer.h"
+#include "LowLatencyScheduler.h"
+#include "JobSystem.h"
+#include "FixedTimestep.h"
+#include "DoubleBuffer.h"
+#include "PresentThread.h"
+#include "FrameRateLimiter.h"
+#include "SubmissionService.h"
 #include "base_widget.h"
 #include "Adapters/VulkanWindowAdapter.h"
 
@@ -37,7 +50,15 @@ class VKWVulkanWindow : public BaseWidget
         VkFormat         surfaceFormat        = VkFormat::VK_FORMAT_B8G8R8A8_UNORM;
         VkFormat         depthFormat          = VkFormat::VK_FORMAT_D32_SFLOAT_S8_UINT;
         VkPresentModeKHR presentMode          = VK_PRESENT_MODE_FIFO_KHR;
+        std::vector<VkPresentModeKHR> presentModes; // ranked list of preferred present modes, eg: {MAILBOX, IMMEDIATE, FIFO_RELAXED, FIFO}
+                                                    // the first one supported by the surface is used. If empty, presentMode is used.
+                                                    // FIFO is always used as the fallback.
         uint32_t         additionalImageCount = 1;// how many additional swapchain images should we create ( total = min_images + additionalImageCount
+        uint32_t         framesInFlight       = 2;// how many frames the CPU can record while the GPU is still processing previous ones.
+                                                  // This is independent of the number of swapchain images.
+        uint32_t         commandThreadCount   = 0;// how many threads can record secondary command buffers for a frame (at least 1 is used).
+                                                  // Each frame slot gets one command pool per thread. See Frame::beginSecondaryCommandBuffer()
+                                                  // This is also the number of threads used by the widget's JobSystem.
     };
 
     struct DeviceInitilizationInfo2
@@ -64,6 +85,76 @@ class VKWVulkanWindow : public BaseWidget
         VkPhysicalDeviceVulkan12Features enabledFeatures12 = {};
         VkPhysicalDeviceVulkan13Features enabledFeatures13 = {};
 
+        // synchronization2 is always enabled if the device supports it and
+        // is used to submit frames. On a 1.3 instance this turns on
+        // enabledFeatures13.synchronization2, otherwise VK_KHR_synchronization2
+        // is enabled. Devices without it use vkQueueSubmit.
+
+        // Use a single timeline semaphore to track frame completion instead
+        // of one fence per frame slot. Each submitted frame signals the
+        // timeline with its frame number. This will automatically turn on
+        // enabledFeatures12.timelineSemaphore. If the device does not
+        // support timeline semaphores, fences will be used.
+        bool timelineFrameScheduler = false;
+
+        // Limit how many presented frames can be queued ahead of the
+        // display. If non-zero, VK_KHR_present_id and VK_KHR_present_wait
+        // are enabled and acquiring frame N waits until frame N-presentLatencyLimit
+        // has been displayed. If the extensions are not supported, this
+        // does nothing. See setPresentLatencyLimit()
+        uint32_t presentLatencyLimit = 0;
+
+        // Render without VkRenderPass/VkFramebuffer objects. Frame::beginRenderPass()
+        // will use vkCmdBeginRendering and transition the swapchain and depth images
+        // itself. This will automatically turn on enabledFeatures13.dynamicRendering.
+        // Requires a Vulkan 1.3 device. If it is not supported, the
+        // default render pass is used.
+        bool dynamicRendering = false;
+
+        // Create a single imageless framebuffer instead of one framebuffer per
+        // swapchain image. The image views are passed when the render pass is begun.
+        // The framebuffer is only recreated when the swapchain extent changes.
+        // This will automatically turn on enabledFeatures12.imagelessFramebuffer.
+        bool imagelessFramebuffer = false;
+    };
+
+    /**
+     * @brief The FramePacing enum
+     *
+     * Determines how the widgets throttle the CPU after a frame
+     * has been presented.
+     *
+     * FrameFence    - Do not wait after presenting. acquireNextFrame() only
+     *                 blocks on the fence of the frame slot it is about to reuse,
+     *                 so the CPU can record while the GPU is rendering.
+     * QueueWaitIdle - Wait for the present queue to go idle after every
+     *                 present. CPU and GPU will never overlap. Useful for debugging.
+     */
+    enum class FramePacing
+    {
+        FrameFence,
+        QueueWaitIdle
+    };
+
+    /**
+     * @brief The AcquireStatus enum
+     *
+     * The result of tryAcquireNextFrame()
+     *
+     * Ready      - The frame was acquired and can be recorded
+     * NotReady   - No frame slot or swapchain image became available
+     *              before the timeout expired. Try again later.
+     * OutOfDate  - The swapchain no longer matches the surface and must be
+     *              rebuilt before a frame can be acquired.
+     * Suboptimal - The frame was acquired and can be recorded, but the
+     *              swapchain should be rebuilt after it has been presented.
+     */
+    enum class AcquireStatus
+    {
+        Ready,
+        NotReady,
+        OutOfDate,
+        Suboptimal
     };
 
     //=================================================================
@@ -85,9 +176,176 @@ class VKWVulkanWindow : public BaseWidget
     {
         m_initInfo2.surface.depthFormat = format;
     }
+    /**
+     * @brief setPresentMode
+     * @param mode
+     *
+     * Sets the present mode. If the swapchain has already been
+     * created, it will be recreated using the new mode the next time
+     * the widget checks swapchainRebuildRequired(). The render pass
+     * and the per-frame objects are kept.
+     */
     void setPresentMode(VkPresentModeKHR mode)
     {
-        m_initInfo2.surface.presentMode = mode;
+        setPresentModes({mode});
+    }
+
+    /**
+     * @brief setPresentModes
+     * @param modes
+     *
+     * Sets a ranked list of present modes. The first one which
+     * is supported by the surface will be used.
+     */
+    void setPresentModes(std::vector<VkPresentModeKHR> modes);
+
+    /**
+     * @brief getPresentMode
+     * @return
+     *
+     * Returns the present mode the current swapchain was created with.
+     */
+    VkPresentModeKHR getPresentMode() const
+    {
+        return m_presentMode;
+    }
+
+    /**
+     * @brief getSupportedPresentModes
+     * @return
+     *
+     * Returns the present modes supported by the surface
+     */
+    std::vector<VkPresentModeKHR> getSupportedPresentModes() const;
+    void setFramePacing(FramePacing pacing)
+    {
+        m_framePacing = pacing;
+    }
+    FramePacing getFramePacing() const
+    {
+        return m_framePacing;
+    }
+    /**
+     * @brief setAcquireTimeout
+     * @param timeout - in nanoseconds
+     *
+     * Sets the timeout the widgets use when acquiring the next frame.
+     * The default, UINT64_MAX, blocks until a frame is available.
+     * A small value lets the exec loop return to the main loop
+     * and continue doing CPU work while the GPU is busy.
+     */
+    void setAcquireTimeout(uint64_t timeout)
+    {
+        m_acquireTimeout = timeout;
+    }
+    uint64_t getAcquireTimeout() const
+    {
+        return m_acquireTimeout;
+    }
+    /**
+     * @brief setPresentLatencyLimit
+     * @param frames
+     *
+     * Sets the maximum number of presented frames which can be queued
+     * ahead of the display. Set to 0 to disable. This only has an effect if
+     * DeviceInitilizationInfo2::presentLatencyLimit was non-zero when the
+     * device was created and the present wait extensions are supported.
+     */
+    void setPresentLatencyLimit(uint32_t frames)
+    {
+        m_presentLatencyLimit = frames;
+    }
+    uint32_t getPresentLatencyLimit() const
+    {
+        return m_presentLatencyLimit;
+    }
+    bool isPresentWaitSupported() const
+    {
+        return m_vkWaitForPresentKHR != nullptr;
+    }
+    /**
+     * @brief setPresentWaitTimeout
+     * @param timeout - in nanoseconds
+     *
+     * The maximum time to wait for a previous frame to be
+     * displayed. If the presentation engine does not display the
+     * frame in time (eg: the window is hidden), the next
+     * frame is started anyway.
+     */
+    void setPresentWaitTimeout(uint64_t timeout)
+    {
+        m_presentWaitTimeout = timeout;
+    }
+    /**
+     * @brief usingDynamicRendering
+     * @return
+     *
+     * Returns true if frames are rendered using dynamic rendering.
+     * In this case getRenderPass() returns VK_NULL_HANDLE and pipelines
+     * should be created with VkPipelineRenderingCreateInfo using the
+     * swapchain and depth formats.
+     */
+    bool usingDynamicRendering() const
+    {
+        return m_dynamicRendering;
+    }
+    /**
+     * @brief getCommandThreadCount
+     * @return
+     *
+     * The number of per-thread command pools in each frame slot,
+     * and the number of threads in the job system. Always at least 1,
+     * so the thread running exec() can record secondary buffers.
+     */
+    uint32_t getCommandThreadCount() const
+    {
+        return std::max<uint32_t>(1u, m_initInfo2.surface.commandThreadCount);
+    }
+    /**
+     * @brief getJobSystem
+     * @return
+     *
+     * Returns the work-stealing thread pool owned by this window.
+     * The widgets start it with getCommandThreadCount() threads
+     * when exec() is called and stop it when exec() returns.
+     */
+    JobSystem & getJobSystem()
+    {
+        return m_jobSystem;
+    }
+    uint32_t getFramesInFlight() const
+    {
+        return static_cast<uint32_t>(m_frameSlots.size());
+    }
+    bool usingTimelineFrameScheduler() const
+    {
+        return m_frameTimeline != VK_NULL_HANDLE;
+    }
+    /**
+     * @brief getFrameTimelineSemaphore
+     * @return
+     *
+     * Returns the timeline semaphore which is signalled with
+     * the frame number when that frame has finished executing on the GPU.
+     * Submissions on other queues can wait on this semaphore to
+     * depend on a specific frame.
+     *
+     * Returns VK_NULL_HANDLE if the timeline frame scheduler is not in use.
+     */
+    VkSemaphore getFrameTimelineSemaphore() const
+    {
+        return m_frameTimeline;
+    }
+    /**
+     * @brief getCurrentFrameNumber
+     * @return
+     *
+     * Returns the frame number of the last frame returned
+     * by acquireNextFrame(). Frame numbers start at 1.
+     */
+    uint64_t getCurrentFrameNumber() const
+    {
+        return m_frameNumber;
     }
     std::vector<VkPhysicalDeviceProperties> getAvailablePhysicalDevices() const
     {
@@ -213,8 +471,32 @@ class VKWVulkanWindow : public BaseWidget
      * you need it.
      *
      * It also contains semaphores to handle synhronization
+     *
+     * The command buffer, command pool, fence and semaphores come
+     * from the next slot in the frames-in-flight ring. This
+     * function waits on that slot's fence before it is reused.
+     *
+     * The returned Frame is owned by the frame slot, and stays
+     * valid until the slot is reused framesInFlight frames later.
      */
-    Frame acquireNextFrame();
+    Frame & acquireNextFrame();
+
+    /**
+     * @brief tryAcquireNextFrame
+     * @param frame
+     * @param timeout - in nanoseconds
+     * @return
+     *
+     * Similar to acquireNextFrame() but does not block longer than
+     * the timeout while waiting for the next frame slot and
+     * for the next swapchain image. frame is only set if
+     * Ready or Suboptimal is returned, and points to the Frame owned
+     * by the frame slot.
+     *
+     * This function does not rebuild the swapchain, if OutOfDate
+     * is returned, call rebuildSwapchain() before trying again.
+     */
+    AcquireStatus tryAcquireNextFrame(Frame *& frame, uint64_t timeout);
 
     /**
      * @brief submitFrame
@@ -226,19 +508,288 @@ class VKWVulkanWindow : public BaseWidget
      */
     void  submitFrame(Frame const & C);
 
+    /**
+     * @brief submitFrame
+     * @param C
+     * @param info
+     *
+     * Submit the frame along with any additional command buffers
+     * and semaphores in info as a single queue submission. If
+     * the device supports synchronization2, vkQueueSubmit2
+     * is used.
+     */
+    void  submitFrame(Frame const & C, FrameSubmitInfo const & info);
+
     void  submitFrameCommandBuffer(VkCommandBuffer cb,
                                    VkSemaphore wait,
                                    VkSemaphore signal,
                                    VkFence fence);
 
+    /**
+     * @brief getCompletedFrameNumber
+     * @return
+     *
+     * Returns the largest frame number N such that all frames
+     * up to and including N have finished executing on the GPU.
+     */
+    uint64_t getCompletedFrameNumber() const;
+
+    /**
+     * @brief waitForFrame
+     * @param frameNumber
+     * @param timeout
+     * @return
+     *
+     * Block until the frame with the given frame number has finished
+     * executing on the GPU. Returns false if the timeout expired.
+     *
+     * The frame must have already been acquired.
+     */
+    bool waitForFrame(uint64_t frameNumber, uint64_t timeout = UINT64_MAX) const;
+
+    bool isFrameComplete(uint64_t frameNumber) const
+    {
+        return getCompletedFrameNumber() >= frameNumber;
+    }
+
     /**
      * @brief presentFrame
      * @param F
      *
      * Present the swapchain frame which was
      * acquired by acquireNextFrame();
+     *
+     * Returns the result of vkQueuePresentKHR. If the swapchain is
+     * out of date or suboptimal, swapchainRebuildRequired() will
+     * return true.
      */
-    void  presentFrame(const Frame &F);
+    VkResult presentFrame(const Frame &F);
+
+    /**
+     * @brief swapchainRebuildRequired
+     * @return
+     *
+     * Returns true if acquiring or presenting reported that the
+     * swapchain is out of date or suboptimal. This is cleared when
+     * the swapchain is rebuilt.
+     */
+    bool swapchainRebuildRequired() const
+    {
+        return m_swapchainRebuildRequired;
+    }
+
+    /**
+     * @brief swapchainOutOfDate
+     * @return
+     *
+     * Returns true if the swapchain can no longer be presented to
+     * and must be rebuilt. Unlike a suboptimal swapchain, this cannot
+     * be deferred.
+     */
+    bool swapchainOutOfDate() const
+    {
+        return m_swapchainOutOfDate;
+    }
+
+    /**
+     * @brief getResizeDebouncer
+     * @return
+     *
+     * The policy used by the widgets to decide when to rebuild
+     * the swapchain while the window is being resized.
+     */
+    ResizeDebouncer & getResizeDebouncer()
+    {
+        return m_resizeDebouncer;
+    }
+
+    /**
+     * @brief setLowLatencyMode
+     * @param enabled
+     *
+     * In low latency mode, the widgets wait for the next frame slot
+     * to become available before polling events, and then delay
+     * the start of the frame by the time predicted by the
+     * LowLatencyScheduler. This way the input used to record the frame
+     * is as recent as possible.
+     */
+    void setLowLatencyMode(bool enabled)
+    {
+        m_lowLatencyMode = enabled;
+    }
+    bool isLowLatencyMode() const
+    {
+        return m_lowLatencyMode;
+    }
+    LowLatencyScheduler & getLowLatencyScheduler()
+    {
+        return m_lowLatencyScheduler;
+    }
+
+    /**
+     * @brief getFixedTimestep
+     * @return
+     *
+     * Set a non-zero timestep to have the widgets call
+     * Application::update(dt) at a fixed rate. The updates for
+     * frame N+1 run on the job system while frame N is recorded.
+     */
+    FixedTimestep & getFixedTimestep()
+    {
+        return m_fixedTimestep;
+    }
+
+    /**
+     * @brief setOnDemandRendering
+     * @param enabled
+     *
+     * When enabled, the widgets block waiting for events while
+     * Application::shouldRender() is false, instead of polling
+     * in a tight loop. Application::requestNextFrame() wakes the
+     * loop up, from any thread.
+     */
+    void setOnDemandRendering(bool enabled)
+    {
+        m_onDemandRendering = enabled;
+    }
+    bool isOnDemandRendering() const
+    {
+        return m_onDemandRendering;
+    }
+
+    /**
+     * @brief setIdleTimeout
+     *
+     * The longest time the widgets block while idle before
+     * going through the loop again.
+     */
+    void setIdleTimeout(std::chrono::milliseconds t)
+    {
+        m_idleTimeout = t;
+    }
+    std::chrono::milliseconds getIdleTimeout() const
+    {
+        return m_idleTimeout;
+    }
+
+    /**
+     * @brief setUnfocusedFrameRateLimit
+     * @param fps - the maximum frame rate while the window does not
+     *              have the input focus. 0 disables the limit.
+     *
+     * While the window is minimized or has a zero extent, the widgets
+     * do not render or rebuild the swapchain at all.
+     */
+    void setUnfocusedFrameRateLimit(double fps)
+    {
+        m_unfocusedFrameRateLimit = fps;
+    }
+    double getUnfocusedFrameRateLimit() const
+    {
+        return m_unfocusedFrameRateLimit;
+    }
+    /**
+     * @brief setFrameRateLimit
+     * @param fps - the maximum frame rate. 0 disables the limit.
+     *
+     * Useful with the IMMEDIATE and MAILBOX present modes, which
+     * are otherwise not limited by the display. The widgets sleep
+     * and then spin until the next frame is due. Use
+     * getFrameRateLimiter() to change the spin threshold or to
+     * read the limiter's jitter.
+     */
+    void setFrameRateLimit(double fps)
+    {
+        m_frameRateLimiter.setTargetFrameRate(fps);
+    }
+    double getFrameRateLimit() const
+    {
+        return m_frameRateLimiter.getTargetFrameRate();
+    }
+    FrameRateLimiter & getFrameRateLimiter()
+    {
+        return m_frameRateLimiter;
+    }
+    bool isWindowMinimized() const
+    {
+        return m_windowMinimized;
+    }
+    bool isWindowFocused() const
+    {
+        return m_windowFocused;
+    }
+
+    /**
+     * @brief setThreadedPresent
+     * @param enabled
+     *
+     * When enabled, presentFrame() hands the frame to a present thread
+     * and returns immediately, instead of blocking in vkQueuePresentKHR.
+     * The present results are collected when the next frame is acquired,
+     * an out of date swapchain is still reported by swapchainOutOfDate().
+     */
+    void setThreadedPresent(bool enabled)
+    {
+        m_threadedPresent = enabled;
+        if( !enabled )
+        {
+            m_presentThread.stop();
+        }
+    }
+    bool isThreadedPresent() const
+    {
+        return m_threadedPresent;
+    }
+
+    /**
+     * @brief setThreadedRendering
+     * @param enabled
+     *
+     * When enabled, the widgets' exec() only pumps the OS events on the
+     * calling thread and forwards them to a render thread, which
+     * acquires, records, submits and presents the frames. A GPU stall
+     * then no longer stops the window from responding.
+     *
+     * The Application and the exec() callbacks are called
+     * from the render thread.
+     *
+     * Must be set before exec() is called.
+     */
+    void setThreadedRendering(bool enabled)
+    {
+        m_threadedRendering = enabled;
+    }
+    bool isThreadedRendering() const
+    {
+        return m_threadedRendering;
+    }
+
+    /**
+     * @brief setRenderThreadAffinity
+     * @param cpuIndex - the logical CPU to pin the render thread to,
+     *                   or -1 to let the OS schedule it.
+     *
+     * Only used in threaded rendering mode.
+     */
+    void setRenderThreadAffinity(int32_t cpuIndex)
+    {
+        m_renderThreadAffinity = cpuIndex;
+    }
+    int32_t getRenderThreadAffinity() const
+    {
+        return m_renderThreadAffinity;
+    }
+
+    /**
+     * @brief waitForNextFrameSlot
+     * @param timeout - in nanoseconds
+     * @return
+     *
+     * Waits until the frame slot used by the next call to
+     * acquireNextFrame() is available, without acquiring a
+     * swapchain image. Returns false if the timeout expired.
+     */
+    bool waitForNextFrameSlot(uint64_t timeout);
 
     /**
      * @brief waitForPresent
@@ -280,6 +831,14 @@ class VKWVulkanWindow : public BaseWidget
     {
         return m_graphicsQueueIndex;
     }
+    /**
+     * @brief getGraphicsQueue
+     * @return
+     *
+     * The queue is also used by the render thread, the present thread
+     * and the SubmissionService. Hold lockQueues() while calling
+     * any vkQueue* function on it.
+     */
     VkQueue getGraphicsQueue() const
     {
         return m_graphicsQueue;
@@ -288,15 +847,54 @@ class VKWVulkanWindow : public BaseWidget
     {
         return m_presentQueueIndex;
     }
+    /**
+     * @brief getPresentQueue
+     * @return
+     *
+     * See getGraphicsQueue()
+     */
     VkQueue getPresentQueue() const
     {
         return m_presentQueue;
     }
-    std::vector<VkImageView> getSwapchainImageViews() const
+    struct QueueLock
+    {
+        std::unique_lock<std::mutex> graphics;
+        std::unique_lock<std::mutex> present; // not locked if the present queue is the graphics queue
+    };
+    /**
+     * @brief lockQueues
+     * @return
+     *
+     * Locks the graphics and present queues. Prefer submitting
+     * through getSubmissionService(), which does not block.
+     */
+    QueueLock lockQueues()
+    {
+        QueueLock L;
+        L.graphics = std::unique_lock<std::mutex>(m_queueMutex);
+        if( &_presentQueueMutex() != &m_queueMutex )
+        {
+            L.present = std::unique_lock<std::mutex>(m_presentQueueMutex);
+        }
+        return L;
+    }
+    /**
+     * @brief getSubmissionService
+     * @return
+     *
+     * Lets any thread submit work to the graphics queue. The
+     * batches are submitted together with the next frame.
+     */
+    SubmissionService & getSubmissionService()
+    {
+        return m_submissionService;
+    }
+    std::vector<VkImageView> const & getSwapchainImageViews() const
     {
         return m_swapchainImageViews;
     }
-    std::vector<VkImage> getSwapchainImages() const
+    std::vector<VkImage> const & getSwapchainImages() const
     {
         return m_swapchainImages;
     }
@@ -324,8 +922,18 @@ class VKWVulkanWindow : public BaseWidget
 
     void rebuildSwapchain()
     {
-        _destroySwapchain(false);
-        _createSwapchain(m_initInfo2.surface.additionalImageCount);
+        // the queued presents still use the old swapchain, and
+        // their results no longer matter once it is replaced
+        if( m_presentThread.isRunning() )
+        {
+            m_presentThread.waitIdle();
+            m_presentThread.takeResults();
+        }
+        auto oldSwapchain = _retireSwapchain();
+        _createSwapchain(m_initInfo2.surface.additionalImageCount, oldSwapchain);
+        m_swapchainRebuildRequired = false;
+        m_swapchainOutOfDate       = false;
+        m_resizeDebouncer.reset();
     }
 
     static VkPhysicalDeviceFeatures2 getSupportedDeviceFeatures(VkPhysicalDevice physicalDevice);
@@ -377,6 +985,7 @@ protected:
     VkQueue                    m_presentQueue  = VK_NULL_HANDLE;
     VkSurfaceCapabilitiesKHR   m_surfaceCapabilities;
     VkSurfaceFormatKHR         m_surfaceFormat;
+    VkPresentModeKHR           m_presentMode = VK_PRESENT_MODE_FIFO_KHR;
     VkExtent2D                 m_swapchainSize;
     VkSwapchainKHR             m_swapchain = VK_NULL_HANDLE;
     std::vector<VkImage>       m_swapchainImages;
@@ -386,18 +995,229 @@ protected:
     VkDeviceMemory             m_depthStencilImageMemory = VK_NULL_HANDLE;
     VkRenderPass               m_renderPass              = VK_NULL_HANDLE;
     std::vector<VkFramebuffer> m_swapchainFrameBuffers;
-    std::vector<VkCommandPool> m_commandPools;
-    std::vector<VkFence>       m_fences;
-    std::vector<VkSemaphore>   m_imageAvailableSemaphores;
-    std::vector<VkSemaphore>   m_renderCompleteSemaphores;
     VkDebugReportCallbackEXT   m_debugCallback = VK_NULL_HANDLE;
-    std::vector<Frame>         m_frames;
+    std::vector<Frame>         m_frames; // one per swapchain image
+
+    /**
+     * @brief The FrameSlot struct
+     *
+     * The objects which are needed to record and submit
+     * a single frame. There are framesInFlight slots which are
+     * used in a round-robin fashion, so that the CPU can record
+     * into one slot while the GPU is still processing the others.
+     */
+    struct FrameSlot
+    {
+        FrameCommandPool commandPool; // reset as a whole when the slot is reused
+        VkCommandBuffer commandBuffer           = VK_NULL_HANDLE;
+        VkFence         fence                   = VK_NULL_HANDLE;
+        VkSemaphore     imageAvailableSemaphore = VK_NULL_HANDLE;
+        VkSemaphore     renderCompleteSemaphore = VK_NULL_HANDLE;
+        uint64_t        frameNumber             = 0; // the last frame which was recorded using this slot
+        std::vector<FrameCommandPool> threadCommandPools; // one per recording thread
+        Frame           frame; // the frame handed out by acquireNextFrame() when this slot is used
+    };
+    std::vector<FrameSlot>     m_frameSlots;
+    uint32_t                   m_frameSlotIndex = 0; // the slot which will be used by the next acquireNextFrame()
+    FramePacing                m_framePacing    = FramePacing::FrameFence;
+    uint64_t                   m_acquireTimeout = UINT64_MAX;
+    uint64_t                   m_frameNumber    = 0; // the frame number of the last acquired frame
+    VkSemaphore                m_frameTimeline  = VK_NULL_HANDLE; // only created when using the timeline frame scheduler
+    PFN_vkQueueSubmit2         m_vkQueueSubmit2 = nullptr;        // null if the device does not support synchronization2
+
+    PFN_vkWaitForPresentKHR    m_vkWaitForPresentKHR = nullptr;   // only loaded when present wait is enabled
+    PFN_vkCmdBeginRendering    m_vkCmdBeginRendering = nullptr;   // only loaded when dynamic rendering is enabled
+    PFN_vkCmdEndRendering      m_vkCmdEndRendering   = nullptr;
+    bool                       m_dynamicRendering    = false;
+    bool                       m_useImagelessFramebuffer = false;
+    VkFramebuffer              m_imagelessFramebuffer       = VK_NULL_HANDLE; // used for all swapchain images
+    VkExtent2D                 m_imagelessFramebufferExtent = {0,0};
+    uint32_t                   m_presentLatencyLimit = 0;
+    uint64_t                   m_presentWaitTimeout  = 100000000; // 100ms
+    uint64_t                   m_firstPresentId      = 0;         // first present id used on the current swapchain
+    uint64_t                   m_lastPresentId       = 0;
+    bool                       m_swapchainRebuildRequired = false;
+    bool                       m_swapchainOutOfDate       = false;
+    ResizeDebouncer            m_resizeDebouncer;
+    LowLatencyScheduler        m_lowLatencyScheduler;
+    JobSystem                  m_jobSystem;
+    FixedTimestep              m_fixedTimestep;
+    JobCounter                 m_updateCounter;
+    uint32_t                   m_updateSteps = 0;
+    double                     m_updateAlpha = 0.0; // interpolation alpha of the update in flight
+    uint32_t                   m_threadCommandPoolCount = 0;
+    bool                       m_lowLatencyMode = false;
+    bool                       m_threadedRendering = false;
+    bool                       m_threadedPresent = false;
+    PresentThread              m_presentThread;
+    // The present queue uses m_queueMutex if it is the
+    // same queue as the graphics queue. The swapchain needs no
+    // lock, while the present thread is running only it uses it.
+    std::mutex                 m_queueMutex;        // guards the graphics queue
+    std::mutex                 m_presentQueueMutex; // guards the present queue
+    SubmissionService          m_submissionService;
+    bool                       m_onDemandRendering = false;
+    std::chrono::milliseconds  m_idleTimeout = std::chrono::milliseconds(100);
+
+    bool                       m_windowMinimized = false;
+    bool                       m_windowFocused   = true;
+    bool                       m_zeroExtent      = false; // the surface has no area, the swapchain cannot be rebuilt
+    bool                       m_rebuildOnResume = false;
+    double                     m_unfocusedFrameRateLimit = 0.0;
+    FrameRateLimiter           m_frameRateLimiter;
+    std::chrono::steady_clock::time_point m_lastFrameTime;
+
+    void _setWindowMinimized(bool minimized)
+    {
+        if( m_windowMinimized && !minimized )
+        {
+            m_rebuildOnResume = true;
+        }
+        m_windowMinimized = minimized;
+    }
+
+    /**
+     * @brief _isPaused
+     * @return
+     *
+     * Returns true if nothing can be seen, no frames
+     * should be rendered.
+     */
+    bool _isPaused() const
+    {
+        return m_windowMinimized || m_zeroExtent;
+    }
+
+    /**
+     * @brief _throttleDelay
+     * @return
+     *
+     * Returns how long to wait before the next frame can be
+     * rendered while the window does not have focus.
+     */
+    std::chrono::milliseconds _throttleDelay() const
+    {
+        if( m_windowFocused || m_unfocusedFrameRateLimit <= 0.0 )
+            return std::chrono::milliseconds(0);
+
+        auto interval  = std::chrono::duration<double>(1.0 / m_unfocusedFrameRateLimit);
+        auto remaining = m_lastFrameTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval)
+                         - std::chrono::steady_clock::now();
+        if( remaining.count() <= 0 )
+            return std::chrono::milliseconds(0);
+        return std::chrono::ceil<std::chrono::milliseconds>(remaining);
+    }
+
+    /**
+     * @brief _cacheDrawableSize
+     *
+     * GLFW and SDL only allow the window size to be queried on the
+     * main thread. With threaded rendering the main thread caches it
+     * before forwarding a resize, and the render thread reads the cache.
+     */
+    void _cacheDrawableSize()
+    {
+        auto e = m_window->getDrawableSize();
+        m_cachedDrawableSize.store( (static_cast<uint64_t>(e.width) << 32) | e.height, std::memory_order_release);
+    }
+    VkExtent2D _getDrawableSize()
+    {
+        if( !m_useCachedDrawableSize )
+            return m_window->getDrawableSize();
+
+        auto v = m_cachedDrawableSize.load(std::memory_order_acquire);
+        return { static_cast<uint32_t>(v >> 32), static_cast<uint32_t>(v & 0xFFFFFFFFu) };
+    }
+
+    std::mutex & _presentQueueMutex()
+    {
+        return m_presentQueueIndex == m_graphicsQueueIndex ? m_queueMutex : m_presentQueueMutex;
+    }
+
+    bool _surfaceExtentIsZero() const;
+    VkResult _acquireNextImage(VkSemaphore semaphore, uint64_t timeout, uint32_t & imageIndex);
+    void _collectPresentResults();
+
+    // used to wake the render thread in threaded rendering mode
+    std::mutex                 m_renderWakeMutex;
+    std::condition_variable    m_renderWakeCondition;
+    bool                       m_renderWakePending = false;
+
+    // set while the exec loop blocks waiting for events, so that
+    // batches queued in the submission service wake it up
+    std::atomic<bool>          m_eventLoopBlocked{false};
+
+    void _notifyRenderThread()
+    {
+        {
+            std::lock_guard<std::mutex> L(m_renderWakeMutex);
+            m_renderWakePending = true;
+        }
+        m_renderWakeCondition.notify_one();
+    }
+
+    void _waitForRenderThreadWake(std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> L(m_renderWakeMutex);
+        m_renderWakeCondition.wait_for(L, timeout, [this](){ return m_renderWakePending; });
+        m_renderWakePending = false;
+    }
+    int32_t                    m_renderThreadAffinity = -1;
+    bool                       m_useCachedDrawableSize = false;
+    std::atomic<uint64_t>      m_cachedDrawableSize{0};
+
+    // Objects belonging to a swapchain which has been replaced
+    // by rebuildSwapchain(). They may still be used by frames or presents
+    // which are in flight and are destroyed once frameNumber has completed,
+    // which is one full round of frames after the swapchain was replaced.
+    struct RetiredSwapchain
+    {
+        VkSwapchainKHR             swapchain = VK_NULL_HANDLE;
+        std::vector<VkImageView>   imageViews;
+        std::vector<VkFramebuffer> frameBuffers;
+        VkImage                    depthStencil            = VK_NULL_HANDLE;
+        VkImageView                depthStencilImageView   = VK_NULL_HANDLE;
+        VkDeviceMemory             depthStencilImageMemory = VK_NULL_HANDLE;
+        uint64_t                   frameNumber = 0;
+    };
+    std::vector<RetiredSwapchain> m_retiredSwapchains;
+
+    // scratch space used when building queue submissions so that
+    // no memory is allocated each frame.
+    struct
+    {
+        std::vector<VkSemaphoreSubmitInfo>     waitInfos;
+        std::vector<VkSemaphoreSubmitInfo>     signalInfos;
+        std::vector<VkCommandBufferSubmitInfo> commandBufferInfos;
+    } m_submitScratch;
 
 protected:
     void             _selectQueueFamily();
     VkDevice         _createDevice();
-    void             _createSwapchain(uint32_t additionalImages);
+    void             _createSwapchain(uint32_t additionalImages, VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE);
     void             _destroySwapchain(bool destroyRenderpass);
+    VkPresentModeKHR _selectPresentMode() const;
+
+    /**
+     * @brief _retireSwapchain
+     * @return the retired swapchain
+     *
+     * Moves the current swapchain and the objects created from it
+     * into the retirement list so that a new swapchain can be created
+     * without waiting for the device to go idle. The returned handle
+     * should be passed as the oldSwapchain to _createSwapchain().
+     */
+    VkSwapchainKHR   _retireSwapchain();
+
+    /**
+     * @brief _releaseRetiredSwapchains
+     * @param force - destroy everything without checking if the frames have completed.
+     *
+     * Destroys the retired swapchains once enough frames have
+     * completed on the new swapchain that the presents queued on
+     * the old one have also finished.
+     */
+    void             _releaseRetiredSwapchains(bool force);
     VkDebugReportCallbackEXT _createDebug(PFN_vkDebugReportCallbackEXT _callback);
 
     std::pair<VkImage, VkDeviceMemory> createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties);
@@ -405,8 +1225,79 @@ protected:
     void _createDepthStencil();
     void _createRenderPass();
     void _createFramebuffers();
+    void _createImagelessFramebuffer();
 
     void _createPerFrameObjects();
+
+    /**
+     * @brief _jobThreadCount
+     * @return
+     *
+     * The number of threads the widgets start the job system with.
+     * A fixed timestep update needs at least one worker thread
+     * to overlap with recording.
+     */
+    uint32_t _jobThreadCount() const
+    {
+        return std::max(getCommandThreadCount(), m_fixedTimestep.isEnabled() ? 2u : 1u);
+    }
+
+    /**
+     * @brief _ensureThreadCommandPools
+     * @param count
+     *
+     * Makes sure every frame slot has at least count per-thread
+     * command pools. Only call this when no frame is being recorded.
+     */
+    void _ensureThreadCommandPools(uint32_t count);
+    void _destroyPerFrameObjects();
+    bool _waitForFrameSlot(FrameSlot const & slot, uint64_t timeout) const;
+
+    /**
+     * @brief _waitForPresentLatency
+     * @param timeout
+     * @return
+     *
+     * Waits until the frame presentLatencyLimit frames before
+     * the next one has been displayed. Returns false if the timeout
+     * expired before the wait cap was reached. When the present
+     * thread is running, the wait is done there instead.
+     */
+    bool _waitForPresentLatency(uint64_t timeout);
+
+    /**
+     * @brief _presentLatencyTarget
+     * @param target
+     * @return
+     *
+     * Returns true and sets target to the present id which has
+     * to be displayed before the next frame can start.
+     */
+    bool _presentLatencyTarget(uint64_t & target) const;
+
+    /**
+     * @brief _beginLowLatencyFrame
+     * @return
+     *
+     * Used by the widgets in low latency mode. Waits for the next frame
+     * slot and sleeps until the predicted start time of the frame.
+     * Returns false if the frame slot did not become available before
+     * the acquire timeout.
+     */
+    bool _beginLowLatencyFrame();
+    void _endLowLatencyFrame()
+    {
+        m_lowLatencyScheduler.cpuEnd();
+    }
+    void _queueSubmit(VkQueue queue, VkFence fence, uint64_t frameNumber);
+
+    /**
+     * @brief _flushSubmissions
+     *
+     * Submits the batches queued in the SubmissionService when
+     * no frame is being rendered, and retires completed tickets.
+     */
+    void _flushSubmissions();
 };
 }
 
@@ -4,16 +4,36 @@
 #include "VKWVulkanWindow.h"
 
 #include <vector>
+#include <array>
 #include <cassert>
 #include <stdexcept>
 #include <set>
 #include <algorithm>
 #include <iostream>
+#include <thread>
 
 namespace vkw
 {
 
-Frame VKWVulkanWindow::acquireNextFrame()
+Frame & VKWVulkanWindow::acquireNextFrame()
+{
+    Frame * f = nullptr;
+    while(true)
+    {
+        auto status = tryAcquireNextFrame(f, UINT64_MAX);
+
+        if( status == AcquireStatus::OutOfDate )
+        {
+            rebuildSwapchain();
+        }
+        else if( status != AcquireStatus::NotReady )
+        {
+            return *f;
+        }
+    }
+}
+
+VKWVulkanWindow::AcquireStatus VKWVulkanWindow::tryAcquireNextFrame(Frame *& frame, uint64_t timeout)
 {
     if( m_swapchain == VK_NULL_HANDLE)
     {
@@ -22,30 +42,374 @@ Frame VKWVulkanWindow::acquireNextFrame()
         _createPerFrameObjects();
     }
 
-    uint32_t frameIndex;
-    vkAcquireNextImageKHR(  m_device,
-                            m_swapchain,
-                            UINT64_MAX-1,
-                            m_imageAvailableSemaphores[0],
-                            VK_NULL_HANDLE,
-                            &frameIndex);
+    // bound the number of frames queued for presentation
+    if( !_waitForPresentLatency(timeout) )
+    {
+        return AcquireStatus::NotReady;
+    }
+
+    auto & slot = m_frameSlots[m_frameSlotIndex];
+
+    // wait until the GPU has finished the last frame which
+    // was recorded using this slot before we reuse its objects
+    if( !_waitForFrameSlot(slot, timeout) )
+    {
+        return AcquireStatus::NotReady;
+    }
+
+    // the slot's render complete semaphore is about to be signalled
+    // again, the present which waits on it must have been issued
+    if( m_presentThread.isRunning() )
+    {
+        m_presentThread.waitUntilPresented(slot.frameNumber);
+        _collectPresentResults();
+    }
+
+    // batches submitted with the frames we just
+    // waited on have also completed
+    m_submissionService.retire(slot.frameNumber);
+
+    uint32_t imageIndex;
+    auto result = _acquireNextImage(slot.imageAvailableSemaphore, timeout, imageIndex);
+
+    switch(result)
+    {
+        case VK_SUCCESS:
+        case VK_SUBOPTIMAL_KHR:
+            break;
+        case VK_NOT_READY:
+        case VK_TIMEOUT:
+            return AcquireStatus::NotReady;
+        case VK_ERROR_OUT_OF_DATE_KHR:
+            m_swapchainRebuildRequired = true;
+            m_swapchainOutOfDate       = true;
+            return AcquireStatus::OutOfDate;
+        default:
+            throw std::runtime_error("Failed to acquire swapchain image");
+    }
+
+    // an image of the current swapchain was acquired, retired
+    // swapchains whose frames have all completed can be destroyed
+    _releaseRetiredSwapchains(false);
+
+    // only reset the fence once we know this slot
+    // will actually be submitted
+    if( slot.fence != VK_NULL_HANDLE )
+    {
+        vkResetFences(m_device, 1, &slot.fence);
+    }
+    slot.commandPool.reset();
+    for(auto & t : slot.threadCommandPools)
+    {
+        t.reset();
+    }
+    // the main command buffer is always the first primary buffer
+    // of the slot's pool, so the pool is always counted as used
+    slot.commandBuffer = slot.commandPool.allocatePrimary();
+
+    slot.frameNumber = ++m_frameNumber;
+
+    // the slot owns its Frame, only update the values which
+    // change from frame to frame instead of copying a new one
+    auto & image = m_frames[imageIndex];
+    auto & f     = slot.frame;
+    f.swapchainIndex          = image.swapchainIndex;
+    f.framebuffer             = image.framebuffer;
+    f.imagelessFramebuffer    = image.imagelessFramebuffer;
+    f.renderPass              = image.renderPass;
+    f.cmdBeginRendering       = image.cmdBeginRendering;
+    f.cmdEndRendering         = image.cmdEndRendering;
+    f.swapchainImage          = image.swapchainImage;
+    f.swapchainImageView      = image.swapchainImageView;
+    f.swapchainFormat         = image.swapchainFormat;
+    f.swapchainSize           = image.swapchainSize;
+    f.depthImage              = image.depthImage;
+    f.depthImageView          = image.depthImageView;
+    f.depthFormat             = image.depthFormat;
+    f.clearColor              = image.clearColor;
+    f.clearDepth              = image.clearDepth;
+
+    f.slotIndex               = m_frameSlotIndex;
+    f.frameNumber             = slot.frameNumber;
+    f.commandPool             = slot.commandPool.commandPool;
+    f.frameCommandPool        = &slot.commandPool;
+    f.commandBuffer           = slot.commandBuffer;
+    f.fence                   = slot.fence;
+    f.imageAvailableSemaphore = slot.imageAvailableSemaphore;
+    f.renderCompleteSemaphore = slot.renderCompleteSemaphore;
+    f.frameTimelineSemaphore  = m_frameTimeline;
+    f.threadCommandPools      = slot.threadCommandPools.data();
+    f.threadCommandPoolCount  = static_cast<uint32_t>(slot.threadCommandPools.size());
+    frame = &f;
+
+    m_frameSlotIndex = (m_frameSlotIndex + 1) % static_cast<uint32_t>(m_frameSlots.size());
+
+    if( result == VK_SUBOPTIMAL_KHR )
+    {
+        m_swapchainRebuildRequired = true;
+        return AcquireStatus::Suboptimal;
+    }
+    return AcquireStatus::Ready;
+}
+
+VkResult VKWVulkanWindow::_acquireNextImage(VkSemaphore semaphore, uint64_t timeout, uint32_t & imageIndex)
+{
+    if( !m_presentThread.isRunning() )
+    {
+        return vkAcquireNextImageKHR(m_device, m_swapchain, timeout, semaphore, VK_NULL_HANDLE, &imageIndex);
+    }
+
+    // the present thread owns the swapchain while it is running,
+    // the acquire is executed there, in order with the presents.
+    // The present latency wait is done there as well.
+    PresentThread::AcquireRequest r;
+    r.swapchain       = m_swapchain;
+    r.signalSemaphore = semaphore;
+    r.timeout         = timeout;
+
+    uint64_t target = 0;
+    if( _presentLatencyTarget(target) )
+    {
+        r.presentWaitId      = target;
+        r.presentWaitCapped  = timeout > m_presentWaitTimeout;
+        r.presentWaitTimeout = r.presentWaitCapped ? m_presentWaitTimeout : timeout;
+    }
+    return m_presentThread.acquire(r, imageIndex);
+}
+
+void VKWVulkanWindow::_collectPresentResults()
+{
+    if( !m_presentThread.isRunning() )
+        return;
+
+    auto r = m_presentThread.takeResults();
+    if( r.outOfDate || r.suboptimal )
+    {
+        m_swapchainRebuildRequired = true;
+    }
+    if( r.outOfDate )
+    {
+        m_swapchainOutOfDate = true;
+    }
+}
+
+bool VKWVulkanWindow::_waitForFrameSlot(FrameSlot const & slot, uint64_t timeout) const
+{
+    if( m_frameTimeline != VK_NULL_HANDLE )
+    {
+        return waitForFrame(slot.frameNumber, timeout);
+    }
+    return VK_SUCCESS == vkWaitForFences(m_device, 1, &slot.fence, VK_TRUE, timeout);
+}
+
+bool VKWVulkanWindow::_presentLatencyTarget(uint64_t & target) const
+{
+    if( m_vkWaitForPresentKHR == nullptr || m_presentLatencyLimit == 0 )
+        return false;
+
+    uint64_t nextFrame = m_frameNumber + 1;
+    if( nextFrame <= m_presentLatencyLimit )
+        return false;
+
+    // only wait on frames which were presented
+    // using the current swapchain
+    target = nextFrame - m_presentLatencyLimit;
+    if( m_firstPresentId == 0 || target < m_firstPresentId || target > m_lastPresentId )
+        return false;
+    return true;
+}
+
+bool VKWVulkanWindow::_waitForPresentLatency(uint64_t timeout)
+{
+    // the present thread waits for the present
+    // before it acquires, see _acquireNextImage()
+    if( m_presentThread.isRunning() )
+        return true;
+
+    uint64_t target = 0;
+    if( !_presentLatencyTarget(target) )
+        return true;
+
+    bool capped = timeout > m_presentWaitTimeout;
+    VkResult result = m_vkWaitForPresentKHR(m_device, m_swapchain, target, capped ? m_presentWaitTimeout : timeout);
+
+    if( result == VK_TIMEOUT )
+    {
+        // the frame was not displayed within the wait cap,
+        // don't stall the application, start the frame anyway
+        return capped;
+    }
+    if( result == VK_ERROR_OUT_OF_DATE_KHR )
+    {
+        m_swapchainRebuildRequired = true;
+        m_swapchainOutOfDate       = true;
+    }
+    return true;
+}
+
+bool VKWVulkanWindow::waitForNextFrameSlot(uint64_t timeout)
+{
+    if( m_frameSlots.empty() )
+        return true;
+
+    if( !_waitForPresentLatency(timeout) )
+        return false;
+
+    return _waitForFrameSlot(m_frameSlots[m_frameSlotIndex], timeout);
+}
+
+bool VKWVulkanWindow::_beginLowLatencyFrame()
+{
+    using clock_type = LowLatencyScheduler::clock_type;
+
+    auto waitStart = clock_type::now();
+    if( !waitForNextFrameSlot(m_acquireTimeout) )
+        return false;
+    auto now = clock_type::now();
+
+    m_lowLatencyScheduler.slotReady(waitStart, now, m_frameNumber - getCompletedFrameNumber());
+
+    auto d = m_lowLatencyScheduler.delay();
+    if( d.count() > 0 )
+    {
+        std::this_thread::sleep_for(d);
+    }
+    m_lowLatencyScheduler.delayed(d);
+    m_lowLatencyScheduler.cpuBegin();
+    return true;
+}
+
+uint64_t VKWVulkanWindow::getCompletedFrameNumber() const
+{
+    if( m_frameTimeline != VK_NULL_HANDLE )
+    {
+        uint64_t value = 0;
+        vkGetSemaphoreCounterValue(m_device, m_frameTimeline, &value);
+        return value;
+    }
+
+    // Frames are submitted to a single queue, so they complete in
+    // order. The oldest slot whose fence has not been signalled yet
+    // is the first frame which has not completed.
+    uint64_t completed = m_frameNumber;
+    for(auto & slot : m_frameSlots)
+    {
+        if( slot.frameNumber != 0 && slot.frameNumber <= completed &&
+            vkGetFenceStatus(m_device, slot.fence) != VK_SUCCESS)
+        {
+            completed = slot.frameNumber - 1;
+        }
+    }
+    return completed;
+}
 
-    vkResetCommandBuffer(m_frames[frameIndex].commandBuffer, 0);
+bool VKWVulkanWindow::waitForFrame(uint64_t frameNumber, uint64_t timeout) const
+{
+    if( m_frameTimeline != VK_NULL_HANDLE )
+    {
+        VkSemaphoreWaitInfo waitInfo = {};
+        waitInfo.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores    = &m_frameTimeline;
+        waitInfo.pValues        = &frameNumber;
+        return VK_SUCCESS == vkWaitSemaphores(m_device, &waitInfo, timeout);
+    }
 
-    vkWaitForFences(m_device, 1, &m_fences[frameIndex], VK_FALSE, UINT64_MAX);
-    vkResetFences(m_device  , 1, &m_fences[frameIndex]);
+    for(auto & slot : m_frameSlots)
+    {
+        if( slot.frameNumber == frameNumber )
+        {
+            return VK_SUCCESS == vkWaitForFences(m_device, 1, &slot.fence, VK_TRUE, timeout);
+        }
+    }
 
-    return m_frames[frameIndex];
+    // The slot has since been reused by a newer frame, so
+    // the requested frame must have already completed.
+    return frameNumber <= m_frameNumber;
 }
 
 void  VKWVulkanWindow::submitFrame(const Frame &C)
 {
-    submitFrameCommandBuffer(C.commandBuffer, C.imageAvailableSemaphore, C.renderCompleteSemaphore, C.fence);
+    submitFrame(C, FrameSubmitInfo());
+}
+
+void  VKWVulkanWindow::submitFrame(const Frame &C, FrameSubmitInfo const & info)
+{
+    m_submitScratch.waitInfos.clear();
+    m_submitScratch.signalInfos.clear();
+    m_submitScratch.commandBufferInfos.clear();
+
+    auto addSemaphore = [](std::vector<VkSemaphoreSubmitInfo> & list, VkSemaphore semaphore, VkPipelineStageFlags2 stageMask, uint64_t value)
+    {
+        VkSemaphoreSubmitInfo S = {};
+        S.sType     = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+        S.semaphore = semaphore;
+        S.stageMask = stageMask;
+        S.value     = value;
+        list.push_back(S);
+    };
+    auto addCommandBuffer = [this](VkCommandBuffer cb)
+    {
+        VkCommandBufferSubmitInfo S = {};
+        S.sType         = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+        S.commandBuffer = cb;
+        m_submitScratch.commandBufferInfos.push_back(S);
+    };
+
+    addSemaphore(m_submitScratch.waitInfos, C.imageAvailableSemaphore, info.swapchainWaitStage, 0);
+    for(auto & w : info.waitSemaphores)
+        addSemaphore(m_submitScratch.waitInfos, w.semaphore, w.stageMask, w.value);
+
+    addSemaphore(m_submitScratch.signalInfos, C.renderCompleteSemaphore, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, 0);
+    if( m_frameTimeline != VK_NULL_HANDLE )
+    {
+        // signal the frame timeline with this frame's number
+        addSemaphore(m_submitScratch.signalInfos, m_frameTimeline, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, C.frameNumber);
+    }
+    for(auto & s : info.signalSemaphores)
+        addSemaphore(m_submitScratch.signalInfos, s.semaphore, s.stageMask, s.value);
+
+    for(auto & cb : info.commandBuffers)
+        addCommandBuffer(cb);
+    addCommandBuffer(C.commandBuffer);
+
+    _queueSubmit(m_graphicsQueue, C.fence, C.frameNumber);
+}
+
+void VKWVulkanWindow::_queueSubmit(VkQueue queue, VkFence fence, uint64_t frameNumber)
+{
+    VkSubmitInfo2 submitInfo = {};
+    submitInfo.sType                    = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+    submitInfo.waitSemaphoreInfoCount   = static_cast<uint32_t>(m_submitScratch.waitInfos.size());
+    submitInfo.pWaitSemaphoreInfos      = m_submitScratch.waitInfos.data();
+    submitInfo.commandBufferInfoCount   = static_cast<uint32_t>(m_submitScratch.commandBufferInfos.size());
+    submitInfo.pCommandBufferInfos      = m_submitScratch.commandBufferInfos.data();
+    submitInfo.signalSemaphoreInfoCount = static_cast<uint32_t>(m_submitScratch.signalInfos.size());
+    submitInfo.pSignalSemaphoreInfos    = m_submitScratch.signalInfos.data();
+
+    // any batches queued by other threads are submitted
+    // ahead of the frame in the same call
+    m_submissionService.submitFrame(queue,
+                                    m_queueMutex,
+                                    m_vkQueueSubmit2,
+                                    m_initInfo2.device.enabledFeatures12.timelineSemaphore,
+                                    submitInfo,
+                                    fence,
+                                    frameNumber);
+}
+
+void VKWVulkanWindow::_flushSubmissions()
+{
+    m_submissionService.flush(m_graphicsQueue,
+                              m_queueMutex,
+                              m_vkQueueSubmit2,
+                              m_initInfo2.device.enabledFeatures12.timelineSemaphore);
+    m_submissionService.retire(getCompletedFrameNumber());
 }
 
 void  VKWVulkanWindow::submitFrameCommandBuffer(VkCommandBuffer cb, VkSemaphore wait, VkSemaphore signal, VkFence fence)
 {
-    VkPipelineStageFlags waitDestStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    VkPipelineStageFlags waitDestStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
     VkSubmitInfo submitInfo         = {};
     submitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -56,11 +420,38 @@ void  VKWVulkanWindow::submitFrameCommandBuffer(VkCommandBuffer cb, VkSemaphore
     submitInfo.pCommandBuffers      = &cb;
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores    = &signal;
+
+    std::lock_guard<std::mutex> L(m_queueMutex);
     vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, fence);
 }
 
-void VKWVulkanWindow::presentFrame(Frame const &F)
+VkResult VKWVulkanWindow::presentFrame(Frame const &F)
 {
+    if( m_threadedPresent )
+    {
+        if( !m_presentThread.isRunning() )
+        {
+            m_presentThread.start(m_device, m_presentQueue, &_presentQueueMutex(), m_vkWaitForPresentKHR);
+        }
+
+        PresentThread::Request r;
+        r.swapchain     = m_swapchain;
+        r.imageIndex    = F.swapchainIndex;
+        r.waitSemaphore = F.renderCompleteSemaphore;
+        r.frameNumber   = F.frameNumber;
+        if( m_vkWaitForPresentKHR != nullptr )
+        {
+            r.presentId = F.frameNumber;
+            if( m_firstPresentId == 0 )
+                m_firstPresentId = F.frameNumber;
+            m_lastPresentId = F.frameNumber;
+        }
+        m_presentThread.push(r);
+
+        // the result is reported later, see _collectPresentResults()
+        return VK_SUCCESS;
+    }
+
     VkPresentInfoKHR presentInfo = {};
     presentInfo.sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfo.waitSemaphoreCount = 1;
@@ -68,11 +459,47 @@ void VKWVulkanWindow::presentFrame(Frame const &F)
     presentInfo.swapchainCount     = 1;
     presentInfo.pSwapchains        = &m_swapchain;
     presentInfo.pImageIndices      = &F.swapchainIndex;
-    vkQueuePresentKHR(m_presentQueue, &presentInfo);
+
+    // tag the present with the frame number so that
+    // we can wait for it to be displayed later
+    VkPresentIdKHR presentId = {};
+    if( m_vkWaitForPresentKHR != nullptr )
+    {
+        presentId.sType          = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        presentId.swapchainCount = 1;
+        presentId.pPresentIds    = &F.frameNumber;
+        presentInfo.pNext        = &presentId;
+
+        if( m_firstPresentId == 0 )
+            m_firstPresentId = F.frameNumber;
+        m_lastPresentId = F.frameNumber;
+    }
+
+    VkResult result;
+    {
+        // other threads may use the queue through lockQueues()
+        std::lock_guard<std::mutex> L(_presentQueueMutex());
+        result = vkQueuePresentKHR(m_presentQueue, &presentInfo);
+    }
+
+    if( result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR )
+    {
+        m_swapchainRebuildRequired = true;
+    }
+    if( result == VK_ERROR_OUT_OF_DATE_KHR )
+    {
+        m_swapchainOutOfDate = true;
+    }
+    return result;
 }
 
 void VKWVulkanWindow::waitForPresent()
 {
+    if( m_presentThread.isRunning() )
+    {
+        m_presentThread.waitIdle();
+    }
+    std::lock_guard<std::mutex> L(_presentQueueMutex());
     vkQueueWaitIdle(m_presentQueue);
 }
 
@@ -141,6 +568,12 @@ void VKWVulkanWindow::_destroySwapchain(bool destroyRenderPass)
     }
     m_swapchainFrameBuffers.clear();
 
+    if( m_imagelessFramebuffer != VK_NULL_HANDLE )
+    {
+        vkDestroyFramebuffer(m_device, m_imagelessFramebuffer, nullptr);
+        m_imagelessFramebuffer = VK_NULL_HANDLE;
+    }
+
     for(auto & f : m_swapchainImageViews)
     {
         vkDestroyImageView(m_device, f, nullptr);
@@ -156,71 +589,166 @@ void VKWVulkanWindow::_destroySwapchain(bool destroyRenderPass)
     }
 }
 
+VkSwapchainKHR VKWVulkanWindow::_retireSwapchain()
+{
+    RetiredSwapchain r;
+
+    r.swapchain               = m_swapchain;
+    r.imageViews              = std::move(m_swapchainImageViews);
+    r.frameBuffers            = std::move(m_swapchainFrameBuffers);
+    r.depthStencil            = m_depthStencil;
+    r.depthStencilImageView   = m_depthStencilImageView;
+    r.depthStencilImageMemory = m_depthStencilImageMemory;
+
+    // the frame fences do not cover the presents which were queued
+    // on the old swapchain, so keep it alive until a full round of
+    // frames has been rendered on the new swapchain as well
+    r.frameNumber             = m_frameNumber + static_cast<uint64_t>(m_frameSlots.size());
+
+    m_swapchain               = VK_NULL_HANDLE;
+    m_depthStencil            = VK_NULL_HANDLE;
+    m_depthStencilImageView   = VK_NULL_HANDLE;
+    m_depthStencilImageMemory = VK_NULL_HANDLE;
+    m_swapchainImageViews.clear();
+    m_swapchainFrameBuffers.clear();
+    m_swapchainImages.clear();
+
+    m_retiredSwapchains.push_back( std::move(r) );
+
+    return m_retiredSwapchains.back().swapchain;
+}
+
+void VKWVulkanWindow::_releaseRetiredSwapchains(bool force)
+{
+    if( m_retiredSwapchains.empty() )
+        return;
+
+    // when forced, the device is idle and every entry can go
+    uint64_t completed = force ? UINT64_MAX : getCompletedFrameNumber();
+
+    auto it = m_retiredSwapchains.begin();
+    while( it != m_retiredSwapchains.end() )
+    {
+        if( it->frameNumber > completed )
+        {
+            ++it;
+            continue;
+        }
+
+        for(auto & f : it->frameBuffers)
+        {
+            vkDestroyFramebuffer(m_device, f, nullptr);
+        }
+        for(auto & v : it->imageViews)
+        {
+            vkDestroyImageView(m_device, v, nullptr);
+        }
+        if( it->depthStencil != VK_NULL_HANDLE )
+        {
+            vkDestroyImageView(m_device, it->depthStencilImageView, nullptr);
+            vkDestroyImage(m_device, it->depthStencil, nullptr);
+            vkFreeMemory(m_device, it->depthStencilImageMemory, nullptr);
+        }
+        if( it->swapchain != VK_NULL_HANDLE )
+        {
+            vkDestroySwapchainKHR(m_device, it->swapchain, nullptr);
+        }
+        it = m_retiredSwapchains.erase(it);
+    }
+}
+
 void VKWVulkanWindow::_createPerFrameObjects()
 {
-    m_fences.resize( m_swapchainImages.size());
-    m_renderCompleteSemaphores.resize( m_swapchainImages.size());
-    m_imageAvailableSemaphores.resize( m_swapchainImages.size());
+    m_frameSlots.resize( std::max(1u, m_initInfo2.surface.framesInFlight) );
+    m_frameSlotIndex = 0;
 
-    //vk::CommandPoolCreateInfo cmdC({}, graphics_queue_index);
-    m_commandPools.resize( m_swapchainImages.size());
-    for(uint32_t i=0;i<m_commandPools.size();i++)
+    bool useTimeline = m_initInfo2.device.timelineFrameScheduler &&
+                       m_initInfo2.device.enabledFeatures12.timelineSemaphore;
+    if( useTimeline )
     {
-        VkCommandPoolCreateInfo cmdC = {};
-        cmdC.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-        cmdC.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-        cmdC.queueFamilyIndex = static_cast< decltype(cmdC.queueFamilyIndex)>(m_graphicsQueueIndex);
+        VkSemaphoreTypeCreateInfo typeCreateInfo = {};
+        typeCreateInfo.sType         = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        typeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        typeCreateInfo.initialValue  = m_frameNumber;
 
-        if( VkResult::VK_SUCCESS != vkCreateCommandPool(m_device, &cmdC, nullptr, &m_commandPools[i]) )
+        VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+        semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreCreateInfo.pNext = &typeCreateInfo;
+
+        if( VkResult::VK_SUCCESS != vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, &m_frameTimeline) )
         {
-            throw std::runtime_error("Failed to create command pool");
+            throw std::runtime_error("Failed to create frame timeline semaphore");
         }
+    }
+
+    for(auto & slot : m_frameSlots)
+    {
+        // the pool is transient, the whole pool is reset when the
+        // slot is reused instead of resetting individual command buffers
+        slot.commandPool.create(m_device, static_cast<uint32_t>(m_graphicsQueueIndex));
+        slot.commandBuffer = slot.commandPool.allocatePrimary();
         //===============
 
-        VkFenceCreateInfo fenceCreateInfo = {};
-        fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-        vkCreateFence(m_device, &fenceCreateInfo, nullptr, &m_fences[i]);
+        slot.threadCommandPools.resize( std::max(getCommandThreadCount(), m_threadCommandPoolCount) );
+        for(auto & t : slot.threadCommandPools)
+        {
+            t.create(m_device, static_cast<uint32_t>(m_graphicsQueueIndex));
+        }
+
+        if( !useTimeline )
+        {
+            VkFenceCreateInfo fenceCreateInfo = {};
+            fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+            vkCreateFence(m_device, &fenceCreateInfo, nullptr, &slot.fence);
+        }
 
         //================
 
         VkSemaphoreCreateInfo semaphoreCreateInfo = {};// = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
         semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-        vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, &m_renderCompleteSemaphores[i] );
-        vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, &m_imageAvailableSemaphores[i] );
+        vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, &slot.renderCompleteSemaphore );
+        vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, &slot.imageAvailableSemaphore );
     }
+}
 
+void VKWVulkanWindow::_ensureThreadCommandPools(uint32_t count)
+{
+    for(auto & slot : m_frameSlots)
+    {
+        while( slot.threadCommandPools.size() < count )
+        {
+            slot.threadCommandPools.emplace_back();
+            slot.threadCommandPools.back().create(m_device, static_cast<uint32_t>(m_graphicsQueueIndex));
+        }
+    }
+    m_threadCommandPoolCount = std::max(m_threadCommandPoolCount, count);
+}
 
-    for(uint32_t i=0;i<m_frames.size();i++)
+void VKWVulkanWindow::_destroyPerFrameObjects()
+{
+    for(auto & slot : m_frameSlots)
     {
-        Frame & f = m_frames[i];
-        f.swapchainIndex = i;
-        f.commandPool    = m_commandPools[i];   // the pool it came from;
-        //f.commandBuffer = ; // the comman buffer to record
-        //f.framebuffer    = m_swapchainFrameBuffers[i];
-        //f.renderPass     = m_renderPass;
-        //f.swapchainImage = m_swapchainImages[i];
-        //f.swapchainImageView = m_swapchainImageViews[i];
-        //f.swapchainSize  = m_swapchainSize;
-        //f.depthImage     = m_depthStencil;
-        //f.depthImageView = m_depthStencilImageView;
-        f.imageAvailableSemaphore = m_imageAvailableSemaphores[0]; // the semaphore you have to wait on.
-        f.renderCompleteSemaphore = m_renderCompleteSemaphores[0]; // the semaphore you have to trigger when you have
-        f.clearColor              = {{1.0f, 1.0f, 1.0f, 1.0f}};
-        f.clearDepth              = {1.0f, 0};
-        f.fence = m_fences[i];
-        VkCommandBufferAllocateInfo allocateInfo = {};
-        allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocateInfo.commandPool = m_commandPools[i];
-        allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocateInfo.commandBufferCount = 1;
-
-        std::vector<VkCommandBuffer>  commandBuffers;
-        commandBuffers.resize(1);
-        vkAllocateCommandBuffers(m_device, &allocateInfo, commandBuffers.data());
-        f.commandBuffer = commandBuffers[0];
-
-        //m_frames.push_back(f);
+        if( slot.fence != VK_NULL_HANDLE )
+            vkDestroyFence(m_device, slot.fence, nullptr);
+        vkDestroySemaphore(m_device, slot.renderCompleteSemaphore, nullptr);
+        vkDestroySemaphore(m_device, slot.imageAvailableSemaphore, nullptr);
+
+        // destroying the pool also frees the command buffer
+        slot.commandPool.destroy();
+
+        for(auto & t : slot.threadCommandPools)
+        {
+            t.destroy();
+        }
+    }
+    m_frameSlots.clear();
+    m_frameSlotIndex = 0;
+
+    if( m_frameTimeline != VK_NULL_HANDLE )
+    {
+        vkDestroySemaphore(m_device, m_frameTimeline, nullptr);
+        m_frameTimeline = VK_NULL_HANDLE;
     }
 }
 
@@ -231,29 +759,22 @@ VKWVulkanWindow::~VKWVulkanWindow()
 
 void VKWVulkanWindow::destroy()
 {
-    for(auto & f : m_fences)
-    {
-        vkDestroyFence(m_device, f, nullptr);
-    }
-    m_fences.clear();
-    for(auto & f : m_renderCompleteSemaphores)
-    {
-        vkDestroySemaphore(m_device, f, nullptr);
-    }
-    m_renderCompleteSemaphores.clear();
-    for(auto & f : m_imageAvailableSemaphores)
+    // finish the queued presents before
+    // the swapchain is destroyed
+    m_presentThread.stop();
+
+    // frames may still be in flight, make sure the
+    // GPU is done with them before we destroy anything
+    if( m_device )
     {
-        vkDestroySemaphore(m_device, f, nullptr);
+        auto L = lockQueues();
+        vkDeviceWaitIdle(m_device);
     }
-    m_imageAvailableSemaphores.clear();
 
+    _releaseRetiredSwapchains(true);
+    m_submissionService.destroy();
 
-
-    for(auto & f : m_commandPools)
-    {
-        vkDestroyCommandPool(m_device, f, nullptr);
-    }
-    m_commandPools.clear();
+    _destroyPerFrameObjects();
 
     _destroySwapchain(true);
 
@@ -261,6 +782,12 @@ void VKWVulkanWindow::destroy()
     {
         vkDestroyDevice(m_device, nullptr);
         m_device = VK_NULL_HANDLE;
+        m_vkQueueSubmit2 = nullptr;
+        m_vkWaitForPresentKHR = nullptr;
+        m_vkCmdBeginRendering = nullptr;
+        m_vkCmdEndRendering   = nullptr;
+        m_dynamicRendering    = false;
+        m_useImagelessFramebuffer = false;
     }
 
     if( m_surface)
@@ -312,9 +839,74 @@ static VkBool32 getSupportedDepthFormat(VkPhysicalDevice physicalDevice, VkForma
         return false;
 }
 
+void VKWVulkanWindow::_createImagelessFramebuffer()
+{
+    if( m_imagelessFramebuffer != VK_NULL_HANDLE )
+    {
+        // the framebuffer only depends on the extent and
+        // formats of the attachments, not the image views
+        if( m_imagelessFramebufferExtent.width  == m_swapchainSize.width &&
+            m_imagelessFramebufferExtent.height == m_swapchainSize.height )
+        {
+            return;
+        }
+
+        // frames in flight may still be using it, retire it
+        // with the swapchain that was just replaced.
+        if( !m_retiredSwapchains.empty() )
+            m_retiredSwapchains.back().frameBuffers.push_back(m_imagelessFramebuffer);
+        else
+            vkDestroyFramebuffer(m_device, m_imagelessFramebuffer, nullptr);
+        m_imagelessFramebuffer = VK_NULL_HANDLE;
+    }
+
+    bool     hasDepth    = m_initInfo2.surface.depthFormat != VK_FORMAT_UNDEFINED;
+    VkFormat depthFormat = getDepthFormat();
+
+    std::array<VkFramebufferAttachmentImageInfo, 2> imageInfos = {};
+    imageInfos[0].sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENT_IMAGE_INFO;
+    imageInfos[0].usage           = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    imageInfos[0].width           = m_swapchainSize.width;
+    imageInfos[0].height          = m_swapchainSize.height;
+    imageInfos[0].layerCount      = 1;
+    imageInfos[0].viewFormatCount = 1;
+    imageInfos[0].pViewFormats    = &m_surfaceFormat.format;
+
+    imageInfos[1] = imageInfos[0];
+    imageInfos[1].usage           = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    imageInfos[1].pViewFormats    = &depthFormat;
+
+    VkFramebufferAttachmentsCreateInfo attachmentsInfo = {};
+    attachmentsInfo.sType                    = VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENTS_CREATE_INFO;
+    attachmentsInfo.attachmentImageInfoCount = hasDepth ? 2 : 1;
+    attachmentsInfo.pAttachmentImageInfos    = imageInfos.data();
+
+    VkFramebufferCreateInfo framebufferInfo = {};
+    framebufferInfo.sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.pNext           = &attachmentsInfo;
+    framebufferInfo.flags           = VK_FRAMEBUFFER_CREATE_IMAGELESS_BIT;
+    framebufferInfo.renderPass      = m_renderPass;
+    framebufferInfo.attachmentCount = attachmentsInfo.attachmentImageInfoCount;
+    framebufferInfo.pAttachments    = nullptr;
+    framebufferInfo.width           = m_swapchainSize.width;
+    framebufferInfo.height          = m_swapchainSize.height;
+    framebufferInfo.layers          = 1;
+
+    if (vkCreateFramebuffer(m_device, &framebufferInfo, nullptr, &m_imagelessFramebuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create imageless framebuffer!");
+    }
+    m_imagelessFramebufferExtent = m_swapchainSize;
+}
+
 void VKWVulkanWindow::_createFramebuffers()
 {
     (void)getSupportedDepthFormat;
+    if( m_useImagelessFramebuffer )
+    {
+        _createImagelessFramebuffer();
+        return;
+    }
     m_swapchainFrameBuffers.resize(m_swapchainImageViews.size());
 
     for (size_t i = 0; i < m_swapchainImageViews.size(); i++)
@@ -391,10 +983,13 @@ void VKWVulkanWindow::_createRenderPass()
 
         dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
         dependencies[0].dstSubpass = 0;
-        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-        dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        // All the frames in flight share the same depth image, so the
+        // depth writes of the previous frame must complete before
+        // this frame clears it.
+        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
         dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
         VkRenderPassCreateInfo renderPassInfo = {};
@@ -534,7 +1129,7 @@ VkDebugReportCallbackEXT VKWVulkanWindow::_createDebug(PFN_vkDebugReportCallback
     return outCallback;
 }
 
-void VKWVulkanWindow::_createSwapchain(uint32_t additionalImages=1)
+void VKWVulkanWindow::_createSwapchain(uint32_t additionalImages, VkSwapchainKHR oldSwapchain)
 {
     using namespace  std;
 
@@ -572,13 +1167,22 @@ void VKWVulkanWindow::_createSwapchain(uint32_t additionalImages=1)
         return std::max( std::min(v, M), m);
     };
 
-    uint32_t width =0,height = 0;
-
-    m_swapchainSize = m_window->getDrawableSize();
-    m_swapchainSize.width  = CLAMP(width,  m_surfaceCapabilities.minImageExtent.width , m_surfaceCapabilities.maxImageExtent.width);
-    m_swapchainSize.height = CLAMP(height, m_surfaceCapabilities.minImageExtent.height, m_surfaceCapabilities.maxImageExtent.height);
+    if( m_surfaceCapabilities.currentExtent.width != UINT32_MAX )
+    {
+        m_swapchainSize = m_surfaceCapabilities.currentExtent;
+    }
+    else
+    {
+        // the surface size is determined by the swapchain
+        m_swapchainSize = _getDrawableSize();
+        m_swapchainSize.width  = CLAMP(m_swapchainSize.width,  m_surfaceCapabilities.minImageExtent.width , m_surfaceCapabilities.maxImageExtent.width);
+        m_swapchainSize.height = CLAMP(m_swapchainSize.height, m_surfaceCapabilities.minImageExtent.height, m_surfaceCapabilities.maxImageExtent.height);
+    }
 
-    m_swapchainSize = m_surfaceCapabilities.currentExtent;
+    if( m_swapchainSize.width == 0 || m_swapchainSize.height == 0 )
+    {
+        throw std::runtime_error("Cannot create a swapchain with a zero extent. The window may be minimized");
+    }
     uint32_t imageCount = m_surfaceCapabilities.minImageCount + additionalImages;
     if (m_surfaceCapabilities.maxImageCount > 0 && imageCount > m_surfaceCapabilities.maxImageCount)
     {
@@ -609,8 +1213,14 @@ void VKWVulkanWindow::_createSwapchain(uint32_t additionalImages=1)
 
     createInfo.preTransform   = m_surfaceCapabilities.currentTransform;
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-    createInfo.presentMode    = m_initInfo2.surface.presentMode;
+    m_presentMode             = _selectPresentMode();
+    createInfo.presentMode    = m_presentMode;
     createInfo.clipped        = VK_TRUE;
+    createInfo.oldSwapchain   = oldSwapchain;
+
+    // present ids are tracked per swapchain
+    m_firstPresentId = 0;
+    m_lastPresentId  = 0;
 
     if(VkResult::VK_SUCCESS != vkCreateSwapchainKHR(m_device, &createInfo, nullptr, &m_swapchain) )
     {
@@ -646,21 +1256,38 @@ void VKWVulkanWindow::_createSwapchain(uint32_t additionalImages=1)
 
 
     _createDepthStencil();
-    if( m_renderPass == VK_NULL_HANDLE)
-        _createRenderPass();
-    _createFramebuffers();
 
-    if(m_frames.size() == 0)
-        m_frames.resize( m_swapchainImages.size() );
+    // with dynamic rendering, the frame begins rendering directly
+    // on the image views, no render pass or framebuffers are needed
+    if( !m_dynamicRendering )
+    {
+        if( m_renderPass == VK_NULL_HANDLE)
+            _createRenderPass();
+        _createFramebuffers();
+    }
+
+    // The swapchain may not have the same number of images
+    // after it has been rebuilt.
+    m_frames.resize( m_swapchainImages.size() );
 
     for(uint32_t i=0;i<m_swapchainImages.size();i++)
     {
         Frame & f = m_frames[i];
 
         f.swapchainIndex = i;
+        f.clearColor     = {{1.0f, 1.0f, 1.0f, 1.0f}};
+        f.clearDepth     = {1.0f, 0};
 
-        f.framebuffer    = m_swapchainFrameBuffers[i];
+        if( m_dynamicRendering )
+            f.framebuffer = VK_NULL_HANDLE;
+        else if( m_useImagelessFramebuffer )
+            f.framebuffer = m_imagelessFramebuffer;
+        else
+            f.framebuffer = m_swapchainFrameBuffers[i];
+        f.imagelessFramebuffer = m_useImagelessFramebuffer && !m_dynamicRendering;
         f.renderPass     = m_renderPass;
+        f.cmdBeginRendering = m_vkCmdBeginRendering;
+        f.cmdEndRendering   = m_vkCmdEndRendering;
         f.swapchainImage = m_swapchainImages[i];
         f.swapchainImageView = m_swapchainImageViews[i];
         f.swapchainSize  = m_swapchainSize;
@@ -672,6 +1299,66 @@ void VKWVulkanWindow::_createSwapchain(uint32_t additionalImages=1)
     }
 }
 
+std::vector<VkPresentModeKHR> VKWVulkanWindow::getSupportedPresentModes() const
+{
+    uint32_t count = 0;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(m_physicalDevice, m_surface, &count, nullptr);
+
+    std::vector<VkPresentModeKHR> modes(count);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(m_physicalDevice, m_surface, &count, modes.data());
+    modes.resize(count);
+    return modes;
+}
+
+bool VKWVulkanWindow::_surfaceExtentIsZero() const
+{
+    VkSurfaceCapabilitiesKHR caps = {};
+    if( VK_SUCCESS != vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_physicalDevice, m_surface, &caps) )
+        return false;
+
+    if( caps.currentExtent.width == UINT32_MAX )
+        return false;
+
+    return caps.currentExtent.width == 0 || caps.currentExtent.height == 0;
+}
+
+VkPresentModeKHR VKWVulkanWindow::_selectPresentMode() const
+{
+    auto supported = getSupportedPresentModes();
+
+    auto requested = m_initInfo2.surface.presentModes;
+    if( requested.empty() )
+    {
+        requested.push_back( m_initInfo2.surface.presentMode );
+    }
+
+    for(auto m : requested)
+    {
+        if( std::find(supported.begin(), supported.end(), m) != supported.end() )
+        {
+            return m;
+        }
+    }
+
+    // FIFO is required to be supported
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+void VKWVulkanWindow::setPresentModes(std::vector<VkPresentModeKHR> modes)
+{
+    if( modes.empty() )
+    {
+        modes.push_back(VK_PRESENT_MODE_FIFO_KHR);
+    }
+    m_initInfo2.surface.presentMode  = modes.front();
+    m_initInfo2.surface.presentModes = std::move(modes);
+
+    if( m_swapchain != VK_NULL_HANDLE && _selectPresentMode() != m_presentMode )
+    {
+        m_swapchainRebuildRequired = true;
+    }
+}
+
 void VKWVulkanWindow::_selectQueueFamily()
 {
     auto physical_devices = m_physicalDevice;
@@ -900,6 +1587,55 @@ void VKWVulkanWindow::createVulkanDevice(const DeviceInitilizationInfo2 &I)
         throw std::runtime_error("Could not find a proper physical device");
     }
     m_initInfo2.device = I;
+    if( m_initInfo2.device.timelineFrameScheduler )
+    {
+        m_initInfo2.device.enabledFeatures12.timelineSemaphore = VK_TRUE;
+    }
+    if( m_initInfo2.device.dynamicRendering )
+    {
+        m_initInfo2.device.enabledFeatures13.dynamicRendering = VK_TRUE;
+    }
+    if( m_initInfo2.device.imagelessFramebuffer )
+    {
+        m_initInfo2.device.enabledFeatures12.imagelessFramebuffer = VK_TRUE;
+    }
+    // synchronization2 is used for frame submissions whenever the
+    // device supports it. Devices which are used through a 1.3 instance
+    // enable the core feature, older ones use VK_KHR_synchronization2.
+    // Devices without either use the legacy vkQueueSubmit path.
+    bool sync2Extension = false;
+    if( m_initInfo2.instance.vulkanVersion >= VK_API_VERSION_1_3 &&
+        getSupportedDeviceFeatures13(m_physicalDevice).synchronization2 )
+    {
+        m_initInfo2.device.enabledFeatures13.synchronization2 = VK_TRUE;
+    }
+    else if( getSupportedDeviceExtensions(m_physicalDevice).count(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME) )
+    {
+        VkPhysicalDeviceSynchronization2FeaturesKHR sync2 = {};
+        sync2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+
+        VkPhysicalDeviceFeatures2 supported = {};
+        supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+        supported.pNext = &sync2;
+        vkGetPhysicalDeviceFeatures2(m_physicalDevice, &supported);
+
+        sync2Extension = sync2.synchronization2 == VK_TRUE;
+        if( sync2Extension )
+        {
+            auto & ext = m_initInfo2.device.deviceExtensions;
+            if( std::find(ext.begin(), ext.end(), VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME) == ext.end() )
+                ext.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+        }
+    }
+    if( m_initInfo2.device.presentLatencyLimit > 0 )
+    {
+        for(auto e : {VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME})
+        {
+            auto & ext = m_initInfo2.device.deviceExtensions;
+            if( std::find(ext.begin(), ext.end(), e) == ext.end() )
+                ext.push_back(e);
+        }
+    }
     // find the proper queue indices
     _selectQueueFamily();
     //==========
@@ -1004,6 +1740,50 @@ void VKWVulkanWindow::createVulkanDevice(const DeviceInitilizationInfo2 &I)
     m_initInfo2.device.enabledFeatures11.pNext = &m_initInfo2.device.enabledFeatures12;
     m_initInfo2.device.enabledFeatures12.pNext = &m_initInfo2.device.enabledFeatures13;
 
+    // present id/wait are not part of the core feature structs
+    // chain them after the 1.3 features if they are supported
+    void * features13Next = m_initInfo2.device.enabledFeatures13.pNext;
+    VkPhysicalDevicePresentIdFeaturesKHR   presentIdFeatures   = {};
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+    bool enablePresentWait = false;
+    if( m_initInfo2.device.presentLatencyLimit > 0 )
+    {
+        auto & ext = m_initInfo2.device.deviceExtensions;
+        bool hasExtensions = std::find(ext.begin(), ext.end(), VK_KHR_PRESENT_ID_EXTENSION_NAME)   != ext.end() &&
+                             std::find(ext.begin(), ext.end(), VK_KHR_PRESENT_WAIT_EXTENSION_NAME) != ext.end();
+
+        presentIdFeatures.sType   = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        presentIdFeatures.pNext   = &presentWaitFeatures;
+
+        if( hasExtensions )
+        {
+            VkPhysicalDeviceFeatures2 supported = {};
+            supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+            supported.pNext = &presentIdFeatures;
+            vkGetPhysicalDeviceFeatures2(m_physicalDevice, &supported);
+        }
+
+        enablePresentWait = presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+        if( enablePresentWait )
+        {
+            presentWaitFeatures.pNext = features13Next;
+            m_initInfo2.device.enabledFeatures13.pNext = &presentIdFeatures;
+        }
+    }
+
+    // the extension feature struct must not be chained together with
+    // the 1.3 feature struct, so it replaces it in the chain. None of the
+    // 1.3 features can be enabled on this path anyway.
+    VkPhysicalDeviceSynchronization2FeaturesKHR sync2Features = {};
+    if( sync2Extension )
+    {
+        sync2Features.sType            = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+        sync2Features.synchronization2 = VK_TRUE;
+        sync2Features.pNext            = m_initInfo2.device.enabledFeatures13.pNext;
+        m_initInfo2.device.enabledFeatures12.pNext = &sync2Features;
+    }
+
     //https://en.wikipedia.org/wiki/Anisotropic_filtering
     //VkPhysicalDeviceFeatures deviceFeatures = {};
     //deviceFeatures.samplerAnisotropy = VK_TRUE;
@@ -1038,9 +1818,44 @@ void VKWVulkanWindow::createVulkanDevice(const DeviceInitilizationInfo2 &I)
         throw std::runtime_error("Failed to create device");
     }
 
+    // the present feature structs only live in this function
+    m_initInfo2.device.enabledFeatures13.pNext = features13Next;
+    m_initInfo2.device.enabledFeatures12.pNext = &m_initInfo2.device.enabledFeatures13;
+
+    m_submissionService.init(m_device, [this]()
+    {
+        _flushSubmissions();
+    });
+
     vkGetDeviceQueue(m_device, static_cast<uint32_t>(m_graphicsQueueIndex), 0, &m_graphicsQueue);
     vkGetDeviceQueue(m_device, static_cast<uint32_t>(m_presentQueueIndex ), 0, &m_presentQueue);
 
+    if( m_initInfo2.device.enabledFeatures13.synchronization2 || sync2Extension )
+    {
+        // core in 1.3, otherwise provided by VK_KHR_synchronization2
+        m_vkQueueSubmit2 = reinterpret_cast<PFN_vkQueueSubmit2>(vkGetDeviceProcAddr(m_device, "vkQueueSubmit2"));
+        if( !m_vkQueueSubmit2 )
+            m_vkQueueSubmit2 = reinterpret_cast<PFN_vkQueueSubmit2>(vkGetDeviceProcAddr(m_device, "vkQueueSubmit2KHR"));
+    }
+
+    if( m_initInfo2.device.enabledFeatures13.dynamicRendering && m_initInfo2.device.dynamicRendering )
+    {
+        // the feature is only enabled through the 1.3 feature struct,
+        // so the core entry points are always available
+        m_vkCmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRendering>(vkGetDeviceProcAddr(m_device, "vkCmdBeginRendering"));
+        m_vkCmdEndRendering   = reinterpret_cast<PFN_vkCmdEndRendering>(vkGetDeviceProcAddr(m_device, "vkCmdEndRendering"));
+        m_dynamicRendering = m_vkCmdBeginRendering && m_vkCmdEndRendering;
+    }
+
+    m_useImagelessFramebuffer = m_initInfo2.device.imagelessFramebuffer &&
+                                m_initInfo2.device.enabledFeatures12.imagelessFramebuffer;
+
+    if( enablePresentWait )
+    {
+        m_vkWaitForPresentKHR = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(m_device, "vkWaitForPresentKHR"));
+        m_presentLatencyLimit = m_initInfo2.device.presentLatencyLimit;
+    }
+
     if( m_swapchain == VK_NULL_HANDLE)
     {
         _createSwapchain(m_initInfo2.surface.additionalImageCount);
@@ -4,7 +4,13 @@
 #include "vulkan_include.h"
 #include <vector>
 #include <string>
+#include <atomic>
+#include <functional>
 #include "Frame.h"
+#include "SecondaryCommandCache.h"
+#include "JobSystem.h"
+#include "FrameCoroutines.h"
+#include "SubmissionService.h"
 
 namespace vkw
 {
@@ -60,6 +66,9 @@ public:
      *
      * After this method is called, another call to initSwapChainResources()
      * will automatically be called.
+     *
+     * The widgets wait for all the frames in flight to complete
+     * before calling this, so the resources can be destroyed immediately.
      */
     virtual void releaseSwapChainResources() = 0;
 
@@ -93,6 +102,31 @@ public:
     virtual void render(Frame &frame) = 0;
 
 
+    /**
+     * @brief update
+     * @param dt - the fixed timestep in seconds
+     *
+     * Only called if the widget has a fixed timestep, see
+     * VKWVulkanWindow::getFixedTimestep(). It is called from a job
+     * system worker, simulating the next frame while render() records
+     * the current one, so it must not modify anything render() reads.
+     * Write the results into the back of a DoubleBuffer instead.
+     */
+    virtual void update(double dt)
+    {
+        (void)dt;
+    }
+
+    /**
+     * @brief publishUpdate
+     *
+     * Called on the render thread after the updates for the
+     * next frame have finished and before render() is called.
+     * Nothing else is running at this point, swap your
+     * DoubleBuffers here.
+     */
+    virtual void publishUpdate() {}
+
     virtual void nativeWindowEvent(void const * e)
     {
         (void)e;
@@ -102,6 +136,13 @@ public:
 
 
 
+    /**
+     * @brief requestNextFrame
+     *
+     * Requests that another frame is rendered. This can be called
+     * from any thread. If the widget is blocked waiting for events
+     * in on-demand rendering mode, it is woken up.
+     */
     void requestNextFrame()
     {
         renderNextFrame();
@@ -109,6 +150,13 @@ public:
     void renderNextFrame()
     {
         m_renderNextFrame=true;
+
+        // the widget sets m_eventLoopIdle before checking shouldRender(),
+        // so either it sees the request or we see that it is idle
+        if( m_eventLoopIdle && m_wakeEventLoop )
+        {
+            m_wakeEventLoop();
+        }
     }
     bool shouldRender() const
     {
@@ -169,11 +217,27 @@ public:
     //=========================================================================
 
 
+    /**
+     * @brief concurrentFrameCount
+     * @return
+     *
+     * The number of frames which can be in flight at the same time.
+     * Any per-frame resources you write to from the CPU (eg: uniform
+     * buffers) should be duplicated this many times.
+     */
     uint32_t concurrentFrameCount() const
     {
         return m_concurrentFrameCount;
     }
 
+    /**
+     * @brief getDefaultRenderPass
+     * @return
+     *
+     * Returns VK_NULL_HANDLE if the window is using dynamic rendering.
+     * Pipelines should then be created using VkPipelineRenderingCreateInfo
+     * with colorFormat() and depthStencilFormat().
+     */
     VkRenderPass getDefaultRenderPass() const
     {
         return m_defaultRenderPass;
@@ -189,10 +253,135 @@ public:
         return m_quit;
     }
 
+    /**
+     * @brief interpolationAlpha
+     * @return
+     *
+     * When using a fixed timestep update, the fraction of a step
+     * which has elapsed since the last published update, in the
+     * range [0,1). Use it to interpolate between the last two
+     * simulated states.
+     */
+    double interpolationAlpha() const
+    {
+        return m_interpolationAlpha;
+    }
+
     uint64_t currentFrameNumber() const
     {
         return m_currentFrameNumber;
     }
+
+    /**
+     * @brief completedFrameNumber
+     * @return
+     *
+     * Returns the frame number of the last frame which has finished
+     * executing on the GPU, as of the start of the current frame.
+     * Resources used by frame N can be reused once
+     * completedFrameNumber() >= N.
+     */
+    uint64_t completedFrameNumber() const
+    {
+        return m_completedFrameNumber;
+    }
+
+    /**
+     * @brief frameSubmitInfo
+     * @return
+     *
+     * Use this inside render() to add command buffers and
+     * semaphores which should be submitted together with the
+     * current frame. Everything is submitted in a single
+     * queue submission. It is cleared after each frame.
+     */
+    FrameSubmitInfo & frameSubmitInfo()
+    {
+        return m_frameSubmitInfo;
+    }
+
+    /**
+     * @brief frameTimelineSemaphore
+     * @return
+     *
+     * If the widget is using the timeline frame scheduler, this
+     * returns the timeline semaphore which is signalled with the
+     * frame number when that frame completes. Submissions to other
+     * queues can wait on it. Otherwise returns VK_NULL_HANDLE.
+     */
+    VkSemaphore frameTimelineSemaphore() const
+    {
+        return m_frameTimelineSemaphore;
+    }
+
+    /**
+     * @brief secondaryCommandCache
+     * @return
+     *
+     * A cache of secondary command buffers for content which
+     * does not change from frame to frame. It is invalidated
+     * before initSwapChainResources() is called. It is not thread
+     * safe, only use it from render().
+     */
+    SecondaryCommandCache & secondaryCommandCache()
+    {
+        return m_secondaryCommandCache;
+    }
+
+    /**
+     * @brief coroutines
+     * @return
+     *
+     * When compiled as C++20, coroutines returning vkw::FrameTask can
+     * co_await coroutines().frameCompleted(n), fenceSignalled(fence),
+     * nextFrame() or swapchainRebuilt(). They are resumed by the
+     * widget's exec loop, without blocking it.
+     */
+    CoroutineScheduler & coroutines()
+    {
+        return m_coroutines;
+    }
+
+    /**
+     * @brief jobSystem
+     * @return
+     *
+     * The work-stealing thread pool owned by the widget. Use it
+     * to spread the work of render() across multiple threads
+     * instead of creating your own threads.
+     *
+     * When the widget uses per-thread command pools, a job can
+     * record into frame.beginSecondaryCommandBuffer(jobSystem().workerIndex()).
+     *
+     * Only valid after initResources() has been called.
+     */
+    JobSystem & jobSystem()
+    {
+        if( !m_jobSystem )
+        {
+            throw std::runtime_error("The job system is not available until initResources() has been called");
+        }
+        return *m_jobSystem;
+    }
+
+    /**
+     * @brief submissionService
+     * @return
+     *
+     * Submits command buffers to the graphics queue from any
+     * thread without locking it. The batches are submitted
+     * ahead of the next frame.
+     *
+     * Only valid after initResources() has been called.
+     */
+    SubmissionService & submissionService()
+    {
+        if( !m_submissionService )
+        {
+            throw std::runtime_error("The submission service is not available until initResources() has been called");
+        }
+        return *m_submissionService;
+    }
 protected:
     friend class SDLVulkanWidget3;
 
@@ -210,10 +399,20 @@ protected:
     std::vector<VkImageView> m_swapchainImageViews;
 
     VkRenderPass             m_defaultRenderPass;
-    bool                     m_quit=false;
-    bool                     m_renderNextFrame=true;
+    std::atomic<bool>        m_quit{false};
+    std::atomic<bool>        m_renderNextFrame{true};
+    double                   m_interpolationAlpha = 0.0;
+    std::atomic<bool>        m_eventLoopIdle{false};
+    std::function<void()>    m_wakeEventLoop; // set by the widget
 
     uint64_t                 m_currentFrameNumber=0;
+    uint64_t                 m_completedFrameNumber=0;
+    VkSemaphore              m_frameTimelineSemaphore = VK_NULL_HANDLE;
+    FrameSubmitInfo          m_frameSubmitInfo;
+    SecondaryCommandCache    m_secondaryCommandCache;
+    JobSystem               *m_jobSystem = nullptr;
+    SubmissionService       *m_submissionService = nullptr;
+    CoroutineScheduler       m_coroutines;
     VkQueue                  m_graphicsQueue;
     VkQueue                  m_presentQueue;
 
@@ -227,6 +426,8 @@ protected:
     friend class SDLVulkanWidget3;
     friend class QTRenderer;
     friend class GLFWVulkanWidget;
+    template<typename Derived>
+    friend class VulkanWidgetBase;
 };
 
 }
@@ -0,0 +1,516 @@
+#ifndef VKW_VULKAN_WIDGET_BASE_H
+#define VKW_VULKAN_WIDGET_BASE_H
+
+#include "VKWVulkanWindow.h"
+#include "VulkanApplication.h"
+#include "Frame.h"
+#include "ThreadAffinity.h"
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <chrono>
+
+namespace vkw {
+
+/**
+ * @brief The VulkanWidgetBase class
+ *
+ * The exec loop shared by the SDL and GLFW widgets. The widgets
+ * only pump their window system's events, everything else, ie:
+ * rebuilding the swapchain, pacing, updating and rendering the
+ * Application, is done here.
+ *
+ * Derived must provide:
+ *
+ *     void _postWakeEvent(); // unblock the event loop, called from any thread
+ */
+template<typename Derived>
+class VulkanWidgetBase : public VKWVulkanWindow
+{
+public:
+    void render( Application * app)
+    {
+        Frame * frame = nullptr;
+        auto status = tryAcquireNextFrame(frame, getAcquireTimeout());
+
+        // if the frame is not ready, return to the main loop and
+        // try again on the next iteration. If the swapchain is
+        // out of date, it will be rebuilt at the start of the next
+        // iteration.
+        if( status == AcquireStatus::NotReady || status == AcquireStatus::OutOfDate )
+        {
+            return;
+        }
+        auto & fr = *frame;
+
+        app->m_currentFrameNumber   = fr.frameNumber;
+        app->m_completedFrameNumber = getCompletedFrameNumber();
+        app->m_secondaryCommandCache.collect(app->m_completedFrameNumber);
+        app->m_coroutines.resume(app->m_completedFrameNumber);
+
+        fr.beginCommandBuffer();
+
+        app->m_renderNextFrame = false;
+        app->render(fr);
+
+        fr.endCommandBuffer();
+        frameReady(fr, app->m_frameSubmitInfo);
+
+        app->m_frameSubmitInfo.clear();
+
+        // only once the frame has been submitted, otherwise
+        // the frame slot would never be signalled
+        app->m_coroutines.rethrowException();
+    }
+
+    /**
+     * @brief frameReady
+     *
+     * Call this function to present the frame.
+     *
+     * When using FramePacing::QueueWaitIdle this will block
+     * until the present queue is idle.
+     */
+    void frameReady(Frame & fr)
+    {
+        frameReady(fr, FrameSubmitInfo());
+    }
+
+    /**
+     * @brief frameReady
+     *
+     * Submit the frame along with the additional command buffers
+     * and semaphores in a single queue submission and present it.
+     */
+    void frameReady(Frame & fr, FrameSubmitInfo const & info)
+    {
+        submitFrame(fr, info);
+        presentFrame(fr);
+        if( m_framePacing == FramePacing::QueueWaitIdle )
+        {
+            waitForPresent();
+        }
+    }
+
+protected:
+    /**
+     * @brief _exec
+     * @param poll - bool(Application*, std::chrono::milliseconds timeout, bool & resize),
+     *               blocks for up to timeout waiting for events, returns false if the window was closed
+     *
+     * The single threaded exec loop.
+     */
+    template<typename POLL_CALLABLE, typename MAIN_LOOP_CALLABLE>
+    int _exec(Application * app, POLL_CALLABLE && poll, MAIN_LOOP_CALLABLE && mainLoop)
+    {
+        _beginExec(app);
+
+        try
+        {
+            while( true )
+            {
+                // in low latency mode, wait for the GPU to be ready
+                // before sampling the input for the next frame
+                bool lowLatency = isLowLatencyMode() && app->shouldRender() && !_isPaused() && _beginLowLatencyFrame();
+
+                // sleep until an event arrives or a frame is requested
+                // if there is nothing to render
+                auto idle = _idleWait(app);
+
+                bool resize = false;
+                bool open   = poll(app, idle, resize);
+
+                app->m_eventLoopIdle = false;
+                m_eventLoopBlocked   = false;
+
+                if( !open || app->shouldQuit() )
+                {
+                    break;
+                }
+                _execFrame(app, resize, mainLoop, lowLatency);
+            }
+        }
+        catch(...)
+        {
+            // release everything before the exception leaves exec()
+            _endExec(app);
+            destroy();
+            throw;
+        }
+
+        _endExec(app);
+        destroy();
+
+        return 0;
+    }
+
+    /**
+     * @brief _execThreaded
+     * @param drain - bool(Application*, bool & resize), called on the render thread
+     *                to handle the forwarded events, returns false if the window was closed
+     * @param pump - void(), called on the calling thread to pump the window system's
+     *               events and forward them to the render thread. It should block for
+     *               a few milliseconds at most.
+     *
+     * The calling thread only pumps the events. The render thread owns
+     * the Application and the acquire/submit/present loop.
+     */
+    template<typename DRAIN_CALLABLE, typename PUMP_CALLABLE, typename MAIN_LOOP_CALLABLE>
+    int _execThreaded(Application * app, DRAIN_CALLABLE && drain, PUMP_CALLABLE && pump, MAIN_LOOP_CALLABLE && mainLoop)
+    {
+        std::atomic<bool>  running(true);
+        std::exception_ptr renderException;
+
+        // the window size can only be queried on this thread
+        _cacheDrawableSize();
+        m_useCachedDrawableSize = true;
+
+        std::thread renderThread([&]()
+        {
+            bool begun = false;
+            try
+            {
+                _beginExec(app);
+                begun = true;
+
+                while( true )
+                {
+                    bool lowLatency = isLowLatencyMode() && app->shouldRender() && !_isPaused() && _beginLowLatencyFrame();
+
+                    bool resize = false;
+                    bool open   = drain(app, resize);
+
+                    if( !open || app->shouldQuit() )
+                    {
+                        break;
+                    }
+                    _execFrame(app, resize, mainLoop, lowLatency);
+
+                    auto idle = _idleWait(app);
+                    if( idle.count() > 0 )
+                    {
+                        _waitForRenderThreadWake(idle);
+                        app->m_eventLoopIdle = false;
+                        m_eventLoopBlocked   = false;
+                    }
+                }
+
+                begun = false;
+                _endExec(app);
+            }
+            catch(...)
+            {
+                renderException = std::current_exception();
+                if( begun )
+                {
+                    try
+                    {
+                        _endExec(app);
+                    }
+                    catch(...)
+                    {
+                    }
+                }
+            }
+            running = false;
+        });
+
+        if( m_renderThreadAffinity >= 0 )
+        {
+            setThreadAffinity(renderThread, static_cast<uint32_t>(m_renderThreadAffinity));
+        }
+
+        while( running )
+        {
+            pump();
+        }
+        renderThread.join();
+        m_useCachedDrawableSize = false;
+
+        destroy();
+
+        if( renderException )
+        {
+            std::rethrow_exception(renderException);
+        }
+
+        return 0;
+    }
+
+    /**
+     * @brief _swapchainNeedsRebuild
+     * @return
+     *
+     * Returns true if the swapchain should be rebuilt now. Resize
+     * events are debounced by the ResizeDebouncer, the old swapchain
+     * keeps being presented until the size is stable. An out of date
+     * swapchain is always rebuilt.
+     */
+    bool _swapchainNeedsRebuild(bool resizeEvent)
+    {
+        // results from the present thread, if it is used
+        _collectPresentResults();
+
+        if( resizeEvent )
+        {
+            m_resizeDebouncer.notifyResize();
+        }
+
+        // the window was restored after being minimized
+        if( swapchainOutOfDate() || m_rebuildOnResume )
+            return true;
+
+        if( m_resizeDebouncer.isPending() )
+            return m_resizeDebouncer.shouldRebuild();
+
+        // suboptimal, but not resizing
+        return swapchainRebuildRequired();
+    }
+
+    void _initSwapchainVars(Application * app)
+    {
+        // the render pass or extent may have changed
+        app->m_secondaryCommandCache.invalidateAll();
+
+        app->m_swapChainSize       = getSwapchainExtent();
+        app->m_swapChainFormat     = getSwapchainFormat();
+        app->m_swapChainDepthFormat= getDepthFormat();
+        app->m_concurrentFrameCount= getFramesInFlight();
+        app->m_defaultRenderPass   = m_renderPass;
+
+        app->m_swapchainImageViews = m_swapchainImageViews;
+        app->m_swapchainImages = m_swapchainImages;
+
+        app->m_currentSwapchainIndex=0;
+    }
+
+    void _beginExec(Application * app)
+    {
+        app->m_device         = getDevice();
+        app->m_physicalDevice = getPhysicalDevice();
+        app->m_instance       = getInstance();
+
+        app->m_graphicsQueue  = getGraphicsQueue();
+        app->m_presentQueue   = getPresentQueue();
+        app->m_graphicsQueueIndex = getGraphicsQueueIndex();
+        app->m_presentQueueIndex  = getPresentQueueIndex();
+        app->m_frameTimelineSemaphore = getFrameTimelineSemaphore();
+        app->m_secondaryCommandCache.init(getDevice(), static_cast<uint32_t>(getGraphicsQueueIndex()));
+        app->m_coroutines.init(getDevice());
+        app->m_wakeEventLoop = [this]()
+        {
+            _wakeEventLoop();
+        };
+
+        // one thread per command pool, so that each job
+        // can record into its own pool using its workerIndex()
+        auto threadCount = _jobThreadCount();
+        _ensureThreadCommandPools(threadCount);
+        m_jobSystem.start(threadCount);
+        app->m_jobSystem = &m_jobSystem;
+
+        // make sure batches submitted by other threads are flushed
+        // even if nothing is rendering. This only wakes the loop,
+        // which flushes them without rendering a frame.
+        m_submissionService.setOwnerThread();
+        m_submissionService.setSubmitCallback([this]()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if( m_eventLoopBlocked )
+            {
+                _wakeEventLoop();
+            }
+        });
+        app->m_submissionService = &m_submissionService;
+
+        _initSwapchainVars(app);
+
+        app->initResources();
+        app->initSwapChainResources();
+    }
+
+    template<typename MAIN_LOOP_CALLABLE>
+    void _execFrame(Application * app, bool resize, MAIN_LOOP_CALLABLE && mainLoop, bool lowLatency)
+    {
+        if( !m_windowMinimized && _swapchainNeedsRebuild(resize) )
+        {
+            // a window with no area cannot have a swapchain, stop
+            // rendering until it has a size again
+            m_zeroExtent = _surfaceExtentIsZero();
+            if( !m_zeroExtent )
+            {
+                // frames still in flight may be using the application's
+                // swapchain resources, wait for them before releasing
+                waitForFrame(m_frameNumber);
+                app->releaseSwapChainResources();
+                rebuildSwapchain();
+                m_rebuildOnResume = false;
+
+                _initSwapchainVars(app);
+                app->initSwapChainResources();
+                app->m_coroutines.notifySwapchainRebuilt();
+                app->m_coroutines.rethrowException();
+
+                // the new swapchain images have not been drawn to
+                app->m_renderNextFrame = true;
+            }
+        }
+
+        mainLoop();
+        if( app->shouldRender() && !_isPaused() && _throttleDelay().count() == 0 &&
+            m_frameRateLimiter.sleepTime().count() == 0 )
+        {
+            // spin for the last part of the frame interval
+            m_frameRateLimiter.wait();
+            m_lastFrameTime = std::chrono::steady_clock::now();
+            if( m_fixedTimestep.isEnabled() )
+            {
+                _pipelineUpdate(app);
+            }
+            render(app);
+        }
+        else
+        {
+            // nothing is rendered, eg: minimized or frame rate
+            // limited, send work queued by other threads anyway
+            _flushSubmissions();
+        }
+        if( lowLatency )
+        {
+            _endLowLatencyFrame();
+        }
+    }
+
+    /**
+     * @brief _pipelineUpdate
+     *
+     * Publishes the updates which were simulated while the previous
+     * frame was recorded, then starts simulating the next frame.
+     */
+    void _pipelineUpdate(Application * app)
+    {
+        m_jobSystem.wait(m_updateCounter);
+        app->publishUpdate();
+
+        // the alpha which belongs to the snapshot just published
+        app->m_interpolationAlpha = m_updateAlpha;
+
+        m_updateSteps = m_fixedTimestep.advance();
+        m_updateAlpha = m_fixedTimestep.alpha();
+
+        if( m_updateSteps > 0 )
+        {
+            // only capture two pointers so the job does not allocate
+            m_jobSystem.submit([this, app]()
+            {
+                auto dt = m_fixedTimestep.getTimestep().count();
+                for(uint32_t i=0; i < m_updateSteps; i++)
+                {
+                    app->update(dt);
+                }
+            }, &m_updateCounter);
+        }
+    }
+
+    /**
+     * @brief _idleWait
+     * @return
+     *
+     * Returns how long the loop can block waiting for events. While
+     * minimized, or idle in on-demand mode, it blocks for the idle
+     * timeout. While unfocused and throttled, or frame rate limited,
+     * until the next frame is due. It does not block while batches
+     * are waiting in the submission service.
+     *
+     * If the loop blocks because it is idle, app->m_eventLoopIdle is
+     * left set so that requestNextFrame() wakes it up. If it blocks at
+     * all, m_eventLoopBlocked is left set so that submitted batches wake
+     * it up. Both must be cleared once the loop is awake again.
+     */
+    std::chrono::milliseconds _idleWait(Application * app)
+    {
+        auto wait = _blockingTime(app);
+        if( wait.count() > 0 )
+        {
+            // either the submitting thread sees the flag
+            // or the loop sees the queued batch
+            m_eventLoopBlocked = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if( !m_submissionService.empty() )
+            {
+                m_eventLoopBlocked   = false;
+                app->m_eventLoopIdle = false;
+                return std::chrono::milliseconds(0);
+            }
+        }
+        return wait;
+    }
+
+    std::chrono::milliseconds _blockingTime(Application * app)
+    {
+        if( _isPaused() )
+            return getIdleTimeout();
+
+        auto throttle = _throttleDelay();
+        if( throttle.count() > 0 )
+            return throttle;
+
+        // wait for events for the coarse part of the frame interval
+        auto limit = m_frameRateLimiter.sleepTime();
+        if( limit.count() > 0 )
+            return limit;
+
+        if( !isOnDemandRendering() || m_resizeDebouncer.isPending() )
+            return std::chrono::milliseconds(0);
+
+        app->m_eventLoopIdle = true;
+        if( app->shouldRender() )
+        {
+            app->m_eventLoopIdle = false;
+            return std::chrono::milliseconds(0);
+        }
+        return getIdleTimeout();
+    }
+
+    /**
+     * @brief _wakeEventLoop
+     *
+     * Called by Application::requestNextFrame(), possibly from
+     * another thread, while the loop is idle.
+     */
+    void _wakeEventLoop()
+    {
+        if( isThreadedRendering() )
+        {
+            _notifyRenderThread();
+        }
+        else
+        {
+            static_cast<Derived*>(this)->_postWakeEvent();
+        }
+    }
+
+    void _endExec(Application * app)
+    {
+        m_jobSystem.stop();
+        app->m_wakeEventLoop = nullptr;
+        m_submissionService.setSubmitCallback(nullptr);
+
+        // the cached command buffers may still be in use
+        m_presentThread.stop();
+        {
+            // other threads may still be using the queues
+            auto L = lockQueues();
+            vkDeviceWaitIdle(getDevice());
+        }
+        app->m_secondaryCommandCache.destroy();
+        app->m_coroutines.destroy();
+
+        app->releaseSwapChainResources();
+        app->releaseResources();
+    }
+};
+
+}
+
+#endif